@@ -4,7 +4,7 @@
 #
 #-------------------------------------------------
 
-QT += core gui widgets sql printsupport core5compat
+QT += core gui widgets sql printsupport concurrent core5compat
 
 # core5compat is only needed for QTextCodec
 # which is needed for opening LibreOffice dictionaries for hunspell
@@ -51,6 +51,9 @@ SOURCES += src/main.cpp\
     src/AppTheme.cpp \
     src/highlighter/EnotStorage.cpp \
     src/highlighter/OriHighlighter.cpp \
+    src/cli/Cli.cpp \
+    src/import/DirImporter.cpp \
+    src/import/EnexImporter.cpp \
     src/pages/AppSettingsPage.cpp \
     src/pages/CssEditorPage.cpp \
     src/pages/PhlEditorPage.cpp \
@@ -58,8 +61,12 @@ SOURCES += src/main.cpp\
     src/spellcheck/LangCodeAndNames.cpp \
     src/MainWindow.cpp \
     src/CatalogWidget.cpp \
+    src/spellcheck/SpellcheckCache.cpp \
     src/spellcheck/Spellchecker.cpp \
+    src/spellcheck/SpellcheckReport.cpp \
+    src/spellcheck/SuggestIndex.cpp \
     src/TextEditHelpers.cpp \
+    src/TextTokenizer.cpp \
     src/Utils.cpp \
     src/catalog/Catalog.cpp \
     src/catalog/CatalogStore.cpp \
@@ -76,9 +83,11 @@ SOURCES += src/main.cpp\
     src/markdown/ori_html.c \
     src/CatalogModel.cpp \
     src/OpenedPagesWidget.cpp \
+    src/StartupTrace.cpp \
     src/pages/HelpPage.cpp \
     src/pages/MemoPage.cpp \
     src/pages/PageWidgets.cpp \
+    src/pages/SpellcheckReportPage.cpp \
     src/pages/SqlConsolePage.cpp \
     src/spellcheck/TextEditSpellcheck.cpp \
     src/widgets/PopupMessage.cpp
@@ -90,12 +99,20 @@ HEADERS  += src/MainWindow.h \
     src/CatalogModel.h \
     src/highlighter/EnotStorage.h \
     src/highlighter/OriHighlighter.h \
+    src/cli/Cli.h \
+    src/import/DirImporter.h \
+    src/import/EnexImporter.h \
+    src/import/Importer.h \
     src/pages/AppSettingsPage.h \
     src/pages/CssEditorPage.h \
     src/pages/PhlEditorPage.h \
     src/pages/QssEditorPage.h \
+    src/spellcheck/SpellcheckCache.h \
     src/spellcheck/Spellchecker.h \
+    src/spellcheck/SpellcheckReport.h \
+    src/spellcheck/SuggestIndex.h \
     src/TextEditHelpers.h \
+    src/TextTokenizer.h \
     src/Utils.h \
     src/catalog/Catalog.h \
     src/catalog/CatalogStore.h \
@@ -111,9 +128,11 @@ HEADERS  += src/MainWindow.h \
     src/widgets/MemoTextEdit.h \
     src/markdown/ori_html.h \
     src/OpenedPagesWidget.h \
+    src/StartupTrace.h \
     src/pages/HelpPage.h \
     src/pages/MemoPage.h \
     src/pages/PageWidgets.h \
+    src/pages/SpellcheckReportPage.h \
     src/pages/SqlConsolePage.h \
     src/spellcheck/TextEditSpellcheck.h \
     src/widgets/PopupMessage.h
@@ -122,6 +122,14 @@ AppSettings::Options AppSettings::options()
                     false,
                     &memoWordWrap
                     ),
+        new OptionSpec<int>(
+                    "Spellcheck",
+                    "memoryBudget",
+                    "Dictionaries memory budget, MB",
+                    "Dictionaries not used by opened memos are unloaded when loaded dictionaries take more memory",
+                    256,
+                    &spellcheckMemoryBudget
+                    ),
         new OptionSpec<bool>(
                     "View",
                     "useNativeMenuBar",
@@ -67,6 +67,8 @@ public:
     QFont memoFont; ///< Default font used to desplay memo content.
     bool memoWordWrap; ///< Whether memo texts should be wrapped by default.
 
+    int spellcheckMemoryBudget; ///< Memory in MB for loaded dictionaries not used by opened memos.
+
     QString markdownCss();
     void updateMarkdownCss(const QString css);
 
@@ -28,47 +28,63 @@ QString saveRawStyleSheet(const QString& text)
     return QString();
 }
 
+namespace {
+
+// Rebuilds the text replacing each match with a string returned by the callback.
+// It's a single pass unlike QString::replace/remove called for each substitution.
+template <typename TReplacer>
+QString replaceMatches(const QString& text, const QRegularExpression& expr, TReplacer replacer)
+{
+    QString result;
+    result.reserve(text.size());
+    qsizetype pos = 0;
+    auto it = expr.globalMatch(text);
+    while (it.hasNext())
+    {
+        auto m = it.next();
+        result += QStringView(text).mid(pos, m.capturedStart() - pos);
+        result += replacer(m);
+        pos = m.capturedEnd();
+    }
+    result += QStringView(text).mid(pos);
+    return result;
+}
+
+} // namespace
+
 QString makeStyleSheet(const QString& rawStyleSheet)
 {
-    QString styleSheet = rawStyleSheet;
+    // It's called at startup and on each change in style sheet editor, so compile expressions once
+    static const QRegularExpression varDefExpr(QStringLiteral("(\\$[a-zA-Z_][a-zA-Z_-]*)\\s*:\\s*(.+);"));
+    static const QRegularExpression varUseExpr(QStringLiteral("\\$[a-zA-Z_][a-zA-Z_-]*"));
+    static const QRegularExpression platformPropExpr(QStringLiteral("^\\s*(windows|linux|macos):(.*)$"),
+        QRegularExpression::CaseInsensitiveOption | QRegularExpression::MultilineOption);
 
-    // Interpolate vars
-    QMap<QString, QString> vars;
-    QRegularExpression varExpr(QStringLiteral("(\\$[a-zA-Z_][a-zA-Z_-]*)\\s*:\\s*(.+);"));
-    auto m = varExpr.match(styleSheet);
-    while (m.hasMatch())
-    {
+    // Collect and remove var definitions
+    QHash<QString, QString> vars;
+    QString styleSheet = replaceMatches(rawStyleSheet, varDefExpr, [&vars](const QRegularExpressionMatch& m){
         vars[m.captured(1)] = m.captured(2);
-        m = varExpr.match(styleSheet, m.capturedEnd());
-    }
-    styleSheet.remove(varExpr);
-    auto it = vars.constBegin();
-    while (it != vars.constEnd())
-    {
-        styleSheet.replace(it.key(), it.value());
-        it++;
-    }
+        return QString();
+    });
+
+    // Interpolate vars, unknown names are left as is
+    if (!vars.isEmpty())
+        styleSheet = replaceMatches(styleSheet, varUseExpr, [&vars](const QRegularExpressionMatch& m){
+            auto it = vars.constFind(m.captured());
+            return it == vars.constEnd() ? m.captured() : it.value();
+        });
 
-    // Process platform-dependeent props
-    auto options = QRegularExpression::CaseInsensitiveOption | QRegularExpression::MultilineOption;
-    QRegularExpression propWin(QStringLiteral("^\\s*windows:(.*)$"), options);
-    QRegularExpression propLinux(QStringLiteral("^\\s*linux:(.*)$"), options);
-    QRegularExpression propMacos(QStringLiteral("^\\s*macos:(.*)$"), options);
+    // Process platform-dependent props
 #if defined(Q_OS_WIN)
-    styleSheet.replace(propWin, QStringLiteral("\\1"));
-    styleSheet.remove(propLinux);
-    styleSheet.remove(propMacos);
-#elif defined(Q_OS_LINUX)
-    styleSheet.replace(propLinux, QStringLiteral("\\1"));
-    styleSheet.remove(propWin);
-    styleSheet.remove(propMacos);
+    static const QString platform("windows");
 #elif defined(Q_OS_MAC)
-    styleSheet.replace(propMacos, QStringLiteral("\\1"));
-    styleSheet.remove(propWin);
-    styleSheet.remove(propLinux);
+    static const QString platform("macos");
+#else
+    static const QString platform("linux");
 #endif
-
-    return styleSheet;
+    return replaceMatches(styleSheet, platformPropExpr, [](const QRegularExpressionMatch& m){
+        return m.captured(1).compare(platform, Qt::CaseInsensitive) == 0 ? m.captured(2) : QString();
+    });
 }
 
 } // namespace AppTheme
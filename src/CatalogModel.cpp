@@ -126,6 +126,12 @@ QModelIndex CatalogModel::itemAdded(const QModelIndex &parent)
     return index(row, 0, parent);
 }
 
+void CatalogModel::itemsReset()
+{
+    beginResetModel();
+    endResetModel();
+}
+
 //------------------------------------------------------------------------------
 //                               ItemRemoverGuard
 //------------------------------------------------------------------------------
@@ -25,6 +25,7 @@ public:
 
     void itemRenamed(const QModelIndex &index);
     QModelIndex itemAdded(const QModelIndex &parent);
+    void itemsReset();
 
     friend class ItemRemoverGuard;
 
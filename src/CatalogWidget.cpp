@@ -133,6 +133,16 @@ void CatalogWidget::setCatalog(Catalog* catalog)
     _catalogView->setModel(_catalogModel);
 }
 
+// Rebuilds the tree after massive changes in the catalog, e.g. after importing
+void CatalogWidget::refresh()
+{
+    if (!_catalogModel) return;
+
+    auto expandedIds = getExpandedIds();
+    _catalogModel->itemsReset();
+    setExpandedIds(expandedIds);
+}
+
 void CatalogWidget::contextMenuRequested(const QPoint &pos)
 {
     if (!_catalogModel) return;
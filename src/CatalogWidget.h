@@ -31,6 +31,7 @@ public:
     CatalogWidget();
 
     void setCatalog(Catalog* catalog);
+    void refresh();
 
     SelectedItems selection() const;
 
@@ -3,10 +3,13 @@
 #include "AppSettings.h"
 #include "CatalogWidget.h"
 #include "OpenedPagesWidget.h"
+#include "StartupTrace.h"
 #include "catalog/Catalog.h"
 #include "catalog/CatalogStore.h"
 #include "highlighter/OriHighlighter.h"
 #include "highlighter/EnotStorage.h"
+#include "import/DirImporter.h"
+#include "import/EnexImporter.h"
 #include "pages/AppSettingsPage.h"
 #include "pages/HelpPage.h"
 #include "pages/PhlEditorPage.h"
@@ -14,9 +17,13 @@
 #include "pages/MemoPage.h"
 #include "pages/SqlConsolePage.h"
 #include "pages/QssEditorPage.h"
+#include "widgets/PopupMessage.h"
 
 #ifdef ENABLE_SPELLCHECK
+#include "pages/SpellcheckReportPage.h"
+#include "spellcheck/SpellcheckCache.h"
 #include "spellcheck/Spellchecker.h"
+#include "spellcheck/SpellcheckReport.h"
 #endif
 
 #include "helpers/OriDialogs.h"
@@ -36,6 +43,7 @@
 #include <QIcon>
 #include <QLabel>
 #include <QMenuBar>
+#include <QProgressDialog>
 #include <QSplitter>
 #include <QStatusBar>
 #include <QStackedWidget>
@@ -100,6 +108,17 @@ void activateOrOpenHighlighEditorPage(QStackedWidget* pagesView, OpenedPagesWidg
     openedPagesView->addOpenedPage(page);
 }
 
+// Importers report progress in arbitrary units (e.g. in bytes),
+// so show it in per mille to fit into the integer range of progress dialog
+ImportProgress makeImportProgress(QProgressDialog* progressDlg)
+{
+    return [progressDlg](qint64 done, qint64 total){
+        progressDlg->setValue(total > 0 ? int(done * 1000 / total) : 0);
+        qApp->processEvents();
+        return !progressDlg->wasCanceled();
+    };
+}
+
 } // namespace
 
 
@@ -184,6 +203,16 @@ void MainWindow::createMenu()
     _actionOpenMemo = m->addAction(tr("Open Memo"), this, &MainWindow::openMemo);
     _actionCreateMemo = m->addAction(tr("New Memo..."), this, [this](){ _catalogView->createMemo(); });
     _actionDeleteMemo = m->addAction(tr("Delete Memo"), this, [this](){ _catalogView->deleteMemo(); });
+    m->addSeparator();
+    _actionImportDir = m->addAction(tr("Import Directory..."), this, &MainWindow::importDirectory);
+    _actionImportEnex = m->addAction(tr("Import Evernote Export..."), this, &MainWindow::importEnex);
+#ifdef ENABLE_SPELLCHECK
+    m->addSeparator();
+    _actionSpellcheckNotebook = m->addAction(tr("Spellcheck Notebook"), this, [this]{ spellcheckReport(nullptr); });
+    _actionSpellcheckFolder = m->addAction(tr("Spellcheck Folder"), this, [this]{
+        spellcheckReport(_catalogView->selection().folder);
+    });
+#endif
 
     m = menuBar()->addMenu(tr("Memo"));
     connect(m, &QMenu::aboutToShow, this, &MainWindow::optionsMenuAboutToShow);
@@ -193,11 +222,8 @@ void MainWindow::createMenu()
 
 #ifdef ENABLE_SPELLCHECK
     _spellcheckMenu = _spellcheckControl->makeMenu(this);
-    if (_spellcheckMenu)
-    {
-        connect(_spellcheckMenu, &QMenu::aboutToShow, this, &MainWindow::spellcheckMenuAboutToShow);
-        m->addMenu(_spellcheckMenu);
-    }
+    connect(_spellcheckMenu, &QMenu::aboutToShow, this, &MainWindow::spellcheckMenuAboutToShow);
+    m->addMenu(_spellcheckMenu);
 #endif
 
     _highlighterMenu = m->addMenu(tr("Highlighter"));
@@ -287,9 +313,8 @@ void MainWindow::loadSettings(QSettings* s)
     int w2 = _splitter->width() - w1 - w3;
     _splitter->setSizes({w1, w2, w3});
 
-    auto lastFile = s->value("database").toString();
-    if (!lastFile.isEmpty())
-        QTimer::singleShot(200, this, [this, lastFile](){ openCatalog(lastFile); });
+    // It will be opened after the window is painted for the first time
+    _startupCatalog = s->value("database").toString();
 }
 
 void MainWindow::loadSession()
@@ -308,12 +333,28 @@ void MainWindow::loadSession()
     _catalogView->setExpandedIds(expandedIds);
 
     QStringList openedIds = settings.value("openedMemos").toString().split(',');
+    QVector<MemoItem*> openedMemos;
     for (const auto& idStr : openedIds)
     {
         auto memoItem = _catalog->findMemoById(idStr.toInt());
-        if (!memoItem) continue;
-        openMemoPage(memoItem);
+        if (memoItem) openedMemos << memoItem;
+    }
+
+#ifdef ENABLE_SPELLCHECK
+    // Dictionaries are loaded in background while memos are opening,
+    // so they are most likely ready when one starts editing a memo
+    QStringList spellcheckLangs;
+    for (auto memoItem : openedMemos)
+    {
+        auto lang = CatalogStore::memoManager()->selectOptions(memoItem->id()).value("spellcheck").toString();
+        if (!lang.isEmpty() && !spellcheckLangs.contains(lang))
+            spellcheckLangs << lang;
     }
+    Spellchecker::preload(spellcheckLangs);
+#endif
+
+    for (auto memoItem : openedMemos)
+        openMemoPage(memoItem);
 
     int activeId = settings.value("activeMemo", -1).toInt();
     auto activeMemoItem = _catalog->findMemoById(activeId);
@@ -394,6 +435,7 @@ void MainWindow::catalogOpened(Catalog* catalog)
     _catalog = catalog;
     connect(_catalog, &Catalog::memoCreated, this, &MainWindow::memoCreated);
     connect(_catalog, &Catalog::memoRemoved, this, &MainWindow::memoRemoved);
+    connect(_catalog, &Catalog::memosImported, this, &MainWindow::updateCounter);
     _catalogView->setCatalog(_catalog);
     auto filePath = _catalog->fileName();
     auto fileName = QFileInfo(filePath).fileName();
@@ -407,7 +449,9 @@ void MainWindow::catalogOpened(Catalog* catalog)
         QSharedPointer<Ori::Highlighter::SpecStorage>(new EnotHighlighterStorage()),
     });
     updateCounter();
+    StartupTrace::mark("Catalog opened");
     loadSession();
+    StartupTrace::mark("Session restored");
 }
 
 bool MainWindow::closeCatalog()
@@ -438,6 +482,13 @@ bool MainWindow::closeAllMemos()
             // TODO: check if was modified
             deletingPages << hleditPage;
 
+#ifdef ENABLE_SPELLCHECK
+        // Reports refer to memos of the catalog being closed
+        auto reportPage = qobject_cast<SpellcheckReportPage*>(widget);
+        if (reportPage)
+            deletingPages << reportPage;
+#endif
+
         auto page = qobject_cast<MemoPage*>(widget);
         if (!page) continue;
         if (!page->canClose())
@@ -482,6 +533,34 @@ void MainWindow::updateMenuCatalog()
     _actionOpenMemo->setEnabled(hasMemo);
     _actionDeleteMemo->setEnabled(hasMemo);
     _actionCreateMemo->setEnabled(hasFolder);
+    _actionImportDir->setEnabled(hasCatalog);
+    _actionImportEnex->setEnabled(hasCatalog);
+#ifdef ENABLE_SPELLCHECK
+    _actionSpellcheckNotebook->setEnabled(hasCatalog);
+    _actionSpellcheckFolder->setEnabled(hasFolder);
+#endif
+}
+
+bool MainWindow::event(QEvent *event)
+{
+    bool res = QMainWindow::event(event);
+    if (event->type() == QEvent::Paint && !_firstPaintDone)
+    {
+        _firstPaintDone = true;
+        StartupTrace::mark("First paint");
+
+        // Children are painted right after the window, so the timer
+        // fires when the whole window is already visible to the user
+        QTimer::singleShot(0, this, [this]{
+            if (!_startupCatalog.isEmpty())
+            {
+                openCatalog(_startupCatalog);
+                _startupCatalog.clear();
+            }
+            StartupTrace::report();
+        });
+    }
+    return res;
 }
 
 void MainWindow::closeEvent(QCloseEvent *event)
@@ -554,6 +633,114 @@ void MainWindow::exportToPdf()
     memoPage->exportToPdf();
 }
 
+void MainWindow::importDirectory()
+{
+    if (!_catalog) return;
+
+    auto dirPath = QFileDialog::getExistingDirectory(this, tr("Import Directory"));
+    if (dirPath.isEmpty()) return;
+
+    // Imported directory becomes a subfolder of the selected one
+    auto target = _catalogView->selection().folder;
+
+    QProgressDialog progressDlg(tr("Importing memos..."), tr("Cancel"), 0, 1000, this);
+    progressDlg.setWindowModality(Qt::WindowModal);
+    progressDlg.setMinimumDuration(500);
+
+    auto res = DirImporter::importDir(_catalog, target, dirPath, makeImportProgress(&progressDlg));
+    importFinished(res);
+}
+
+void MainWindow::importEnex()
+{
+    if (!_catalog) return;
+
+    auto fileName = QFileDialog::getOpenFileName(this, tr("Import Evernote Export"),
+                                                 QString(), EnexImporter::fileFilter());
+    if (fileName.isEmpty()) return;
+
+    // Imported notebook becomes a subfolder of the selected one
+    auto target = _catalogView->selection().folder;
+
+    QProgressDialog progressDlg(tr("Importing notes..."), tr("Cancel"), 0, 1000, this);
+    progressDlg.setWindowModality(Qt::WindowModal);
+    progressDlg.setMinimumDuration(500);
+
+    auto res = EnexImporter::importFile(_catalog, target, fileName,
+                                        markdownMemoType(), makeImportProgress(&progressDlg));
+    importFinished(res);
+}
+
+void MainWindow::spellcheckReport(FolderItem* folder)
+{
+#ifdef ENABLE_SPELLCHECK
+    if (!_catalog) return;
+
+    QVector<int> memoIds;
+    if (folder)
+        _catalog->fillMemoIdsFlat(folder, memoIds);
+    else
+        for (auto item : _catalog->items())
+        {
+            if (item->isFolder())
+                _catalog->fillMemoIdsFlat(item->asFolder(), memoIds);
+            else memoIds << item->id();
+        }
+
+    QProgressDialog progressDlg(tr("Spellchecking memos..."), tr("Cancel"), 0, memoIds.size(), this);
+    progressDlg.setWindowModality(Qt::WindowModal);
+    progressDlg.setMinimumDuration(500);
+
+    auto res = SpellcheckReport::checkMemos(memoIds, [&progressDlg](int done, int total){
+        progressDlg.setMaximum(total);
+        progressDlg.setValue(done);
+        qApp->processEvents();
+        return !progressDlg.wasCanceled();
+    });
+    progressDlg.close();
+
+    if (!res.error.isEmpty())
+        return Ori::Dlg::error(tr("Spellchecking failed\n\n%1").arg(res.error));
+
+    if (res.checked == 0 && !res.canceled)
+        return PopupMessage::affirm(tr("There are no memos with spellcheck enabled"));
+
+    auto title = folder ? tr("Spellcheck: %1").arg(folder->title()) : tr("Spellcheck: Notebook");
+    auto page = new SpellcheckReportPage(_catalog, title, res);
+    connect(page, &SpellcheckReportPage::openMemo, this, &MainWindow::openMemoPage);
+    _pagesView->addWidget(page);
+    _pagesView->setCurrentWidget(page);
+    _openedPagesView->addOpenedPage(page);
+#else
+    Q_UNUSED(folder)
+#endif
+}
+
+void MainWindow::importFinished(const ImportResult& res)
+{
+    _catalogView->refresh();
+    updateCounter();
+
+    if (!res.error.isEmpty())
+        return Ori::Dlg::error(tr("Importing failed, imported memos: %1\n\n%2").arg(res.imported).arg(res.error));
+
+    if (!res.warnings.isEmpty())
+    {
+        const int maxWarnings = 20;
+        auto warnings = res.warnings.mid(0, maxWarnings);
+        if (res.warnings.size() > maxWarnings)
+            warnings << QStringLiteral("...");
+        Ori::Dlg::warning(tr("Imported memos: %1\n\nSome items were not imported:\n\n%2")
+                          .arg(res.imported).arg(warnings.join('\n')));
+        return;
+    }
+
+    if (res.canceled)
+        PopupMessage::affirm(tr("Importing canceled, imported memos: %1").arg(res.imported));
+    else
+        PopupMessage::affirm(tr("Imported memos: %1").arg(res.imported));
+}
+
 void MainWindow::chooseMemoFont()
 {
     auto memoPage = currentMemoPage();
@@ -592,6 +779,14 @@ void MainWindow::memoRemoved(MemoItem* item)
 
     auto page = findMemoPage(item);
     if (page) page->deleteLater();
+
+#ifdef ENABLE_SPELLCHECK
+    // The same key as MemoPage gives to its editor
+    if (page) page->dropSpellcheckResults();
+    auto catalogUid = _catalog->uid();
+    if (!catalogUid.isEmpty())
+        SpellcheckCache::remove(catalogUid + '/' + QString::number(item->id()));
+#endif
 }
 
 void MainWindow::optionsMenuAboutToShow()
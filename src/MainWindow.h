@@ -18,6 +18,8 @@ class SpellcheckControl;
 class InfoWidget;
 class MemoPage;
 class MemoItem;
+class FolderItem;
+struct ImportResult;
 
 namespace Ori {
 class MruFileList;
@@ -40,6 +42,7 @@ public:
     void saveSettings(QSettings* s);
 
 protected:
+    bool event(QEvent *event) override;
     void closeEvent(QCloseEvent *event) override;
 
 private:
@@ -53,7 +56,11 @@ private:
     QAction *_actionCreateTopLevelFolder, *_actionCreateFolder, *_actionRenameFolder, *_actionDeleteFolder;
     QAction *_actionMemoFont, *_actionWordWrap, *_actionMemoExportPdf;
     QAction *_actionOpenMemo, *_actionCreateMemo, *_actionDeleteMemo;
+    QAction *_actionImportDir, *_actionImportEnex;
+    QAction *_actionSpellcheckNotebook = nullptr, *_actionSpellcheckFolder = nullptr;
     QString _lastOpenedCatalog;
+    QString _startupCatalog;
+    bool _firstPaintDone = false;
     SpellcheckControl* _spellcheckControl;
     Ori::Highlighter::Control* _highlighterControl;
     QMenu *_spellcheckMenu = nullptr;
@@ -78,6 +85,10 @@ private:
     bool closeAllMemos();
     void openMemoPage(MemoItem* item);
     void exportToPdf();
+    void importDirectory();
+    void importEnex();
+    void importFinished(const ImportResult& res);
+    void spellcheckReport(FolderItem* folder);
     MemoPage* findMemoPage(MemoItem* item) const;
     MemoPage* currentMemoPage() const;
     void optionsMenuAboutToShow();
@@ -0,0 +1,60 @@
+#include "StartupTrace.h"
+
+#include "AppSettings.h"
+
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QVector>
+
+namespace StartupTrace {
+namespace {
+
+struct Phase
+{
+    const char* name;
+    qint64 elapsed; // since the previous phase, ns
+};
+
+struct Trace
+{
+    QElapsedTimer timer;
+    QVector<Phase> phases;
+    qint64 lastMark = 0;
+    bool reported = false;
+
+    // The timer starts at the first mark in main(), it is near enough to the process start
+    Trace() { timer.start(); }
+};
+
+Trace& trace()
+{
+    static Trace t;
+    return t;
+}
+
+} // namespace
+
+void mark(const char* phase)
+{
+    auto& t = trace();
+    if (t.reported) return;
+    qint64 now = t.timer.nsecsElapsed();
+    t.phases.append({phase, now - t.lastMark});
+    t.lastMark = now;
+}
+
+void report()
+{
+    auto& t = trace();
+    if (t.reported) return;
+    t.reported = true;
+
+    if (!AppSettings::instance().isDevMode) return;
+
+    qDebug() << "Startup phases:";
+    for (const auto& phase : t.phases)
+        qDebug().noquote() << QString("  %1 ms").arg(phase.elapsed / 1.0e6, 8, 'f', 2) << phase.name;
+    qDebug().noquote() << QString("  %1 ms").arg(t.lastMark / 1.0e6, 8, 'f', 2) << "Total";
+}
+
+} // namespace StartupTrace
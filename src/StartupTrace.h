@@ -0,0 +1,16 @@
+#ifndef STARTUP_TRACE_H
+#define STARTUP_TRACE_H
+
+// Measures how long startup phases take.
+// Phases are always recorded (it's cheap), the report is only printed in dev mode.
+namespace StartupTrace {
+
+// Marks the end of a phase started at the previous mark (or at the app start).
+void mark(const char* phase);
+
+// Prints collected phases once, subsequent calls do nothing.
+void report();
+
+} // namespace StartupTrace
+
+#endif // STARTUP_TRACE_H
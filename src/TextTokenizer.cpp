@@ -0,0 +1,142 @@
+#include "TextTokenizer.h"
+
+namespace {
+
+enum CharClass
+{
+    Other = 0,
+    Letter = 1,
+    Digit = 2,
+    WordChar = Letter | Digit,
+};
+
+// Most of memo text is Latin-1, so its classes are taken from the table
+// and QChar's unicode tables are only consulted for other characters
+struct Latin1Classes
+{
+    unsigned char classes[256];
+
+    Latin1Classes()
+    {
+        for (int c = 0; c < 256; c++)
+        {
+            QChar ch(c);
+            classes[c] = ch.isLetter() ? Letter : ch.isDigit() ? Digit : Other;
+        }
+    }
+};
+
+const Latin1Classes latin1;
+
+inline int unicodeClass(char32_t c)
+{
+    // Combining marks continue words, e.g. accents in decomposed text
+    if (QChar::isLetter(c) || QChar::isMark(c)) return Letter;
+    if (QChar::isNumber(c)) return Digit;
+    return Other;
+}
+
+inline bool isApostrophe(QChar c)
+{
+    return c == QLatin1Char('\'') || c == QChar(0x2019) || c == QChar(0x02BC);
+}
+
+inline bool isNumberSeparator(QChar c)
+{
+    return c == QLatin1Char('.') || c == QLatin1Char(',');
+}
+
+} // namespace
+
+int TextTokenizer::charClass(int pos, int* width) const
+{
+    *width = 1;
+    char16_t c = _text.at(pos).unicode();
+    if (c < 256)
+        return latin1.classes[c];
+    if (QChar::isHighSurrogate(c) && pos + 1 < _text.size() && _text.at(pos + 1).isLowSurrogate())
+    {
+        *width = 2;
+        return unicodeClass(QChar::surrogateToUcs4(c, _text.at(pos + 1).unicode()));
+    }
+    return unicodeClass(c);
+}
+
+// Abbreviation is two or more single letters each followed by a dot
+bool TextTokenizer::tryAbbreviation()
+{
+    const int size = _text.size();
+    int pos = _start;
+    int letters = 0;
+    int width;
+    while (pos + 1 < size && _text.at(pos + 1) == QLatin1Char('.') &&
+           charClass(pos, &width) == Letter && width == 1)
+    {
+        pos += 2;
+        letters++;
+    }
+    if (letters < 2) return false;
+    if (pos < size && (charClass(pos, &width) & WordChar)) return false;
+    _stop = pos;
+    _isAbbreviation = true;
+    return true;
+}
+
+bool TextTokenizer::next()
+{
+    const int size = _text.size();
+    int pos = _stop;
+    int width;
+
+    while (pos < size && !(charClass(pos, &width) & WordChar))
+        pos += width;
+    if (pos >= size)
+    {
+        _start = _stop = size;
+        return false;
+    }
+
+    _start = pos;
+    _isAbbreviation = false;
+    if (tryAbbreviation()) return true;
+
+    int prevClass = Other;
+    while (pos < size)
+    {
+        int cls = charClass(pos, &width);
+        if (cls & WordChar)
+        {
+            prevClass = cls;
+            pos += width;
+            continue;
+        }
+
+        // Apostrophe or number separator only joins if the next char is of the same kind
+        QChar c = _text.at(pos);
+        if (pos + 1 < size)
+        {
+            int nextClass = charClass(pos + 1, &width);
+            if (prevClass == Letter && nextClass == Letter && isApostrophe(c))
+            {
+                pos += 1 + width;
+                continue;
+            }
+            if (prevClass == Digit && nextClass == Digit && isNumberSeparator(c))
+            {
+                pos += 1 + width;
+                continue;
+            }
+        }
+        break;
+    }
+    _stop = pos;
+    return true;
+}
+
+int TextTokenizer::countWords(QStringView text)
+{
+    int count = 0;
+    TextTokenizer words(text);
+    while (words.next()) count++;
+    return count;
+}
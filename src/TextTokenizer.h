@@ -0,0 +1,44 @@
+#ifndef TEXT_TOKENIZER_H
+#define TEXT_TOKENIZER_H
+
+#include <QStringView>
+
+// Splits text into words, it's shared by spellcheck and text statistics.
+//
+// Words are runs of letters and digits. Apostrophes between letters are parts
+// of words (don't, O’Neil), so are separators between digits (3.14, 1,000).
+// Dotted abbreviations (e.g., U.S.A.) are single words including their dots.
+//
+// The tokenizer works on the text directly and does not allocate,
+// words are returned as positions in the text.
+//
+//     TextTokenizer words(text);
+//     while (words.next())
+//         check(text.mid(words.start(), words.length()));
+//
+class TextTokenizer
+{
+public:
+    explicit TextTokenizer(QStringView text): _text(text) {}
+
+    // Moves to the next word, returns false when there are no more words.
+    bool next();
+
+    int start() const { return _start; }
+    int length() const { return _stop - _start; }
+    QStringView word() const { return _text.sliced(_start, _stop - _start); }
+    bool isAbbreviation() const { return _isAbbreviation; }
+
+    static int countWords(QStringView text);
+
+private:
+    QStringView _text;
+    int _start = 0;
+    int _stop = 0;
+    bool _isAbbreviation = false;
+
+    int charClass(int pos, int* width) const;
+    bool tryAbbreviation();
+};
+
+#endif // TEXT_TOKENIZER_H
@@ -59,6 +59,12 @@ const QString CatalogItem::path() const
     return path.join('/');
 }
 
+QString CatalogItem::displayPath() const
+{
+    auto p = path();
+    return p.isEmpty() ? _title : p + '/' + _title;
+}
+
 //------------------------------------------------------------------------------
 //                                  FolderItem
 //------------------------------------------------------------------------------
@@ -261,6 +267,48 @@ MemoResult Catalog::createMemo(FolderItem* parent, MemoItem* item, MemoType* mem
     return MemoResult::ok(item);
 }
 
+MemoListResult Catalog::importMemos(FolderItem* parent, const QVector<MemoImportParam>& memos)
+{
+    auto now = QDateTime::currentDateTime();
+
+    QVector<MemoItem*> items;
+    items.reserve(memos.size());
+    for (const auto& memo : memos)
+    {
+        auto item = new MemoItem;
+        item->_parent = parent;
+        item->_title = memo.title;
+        item->_data = memo.data;
+        item->_type = memo.type ? memo.type : plainTextMemoType();
+        item->_created = memo.created.isValid() ? memo.created : now;
+        item->_updated = memo.updated.isValid() ? memo.updated : item->_created;
+        item->_station = _station;
+        items << item;
+    }
+
+    auto res = CatalogStore::memoManager()->createAll(items);
+    if (!res.isEmpty())
+    {
+        qDeleteAll(items);
+        return MemoListResult::fail(res);
+    }
+
+    auto& children = parent ? parent->_children : _items;
+    for (auto item : items)
+    {
+        // Imported texts can be huge and there can be a lot of them,
+        // don't keep them in memory, memo will be reloaded when opened
+        item->_data.clear();
+
+        children.append(item);
+        _allMemos.insert(item->id(), item);
+    }
+
+    emit memosImported(parent, items);
+
+    return MemoListResult::ok(items);
+}
+
 QString Catalog::updateMemo(MemoItem* item, MemoUpdateParam update)
 {
     update.moment = QDateTime::currentDateTime();
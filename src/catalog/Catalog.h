@@ -4,6 +4,7 @@
 #include <QObject>
 #include <QList>
 #include <QMap>
+#include <QVector>
 #include <QIcon>
 #include <QDateTime>
 
@@ -66,6 +67,15 @@ struct MemoUpdateParam
     QString station;
 };
 
+struct MemoImportParam
+{
+    QString title;
+    QString data;
+    MemoType* type = nullptr;
+    QDateTime created;
+    QDateTime updated;
+};
+
 //------------------------------------------------------------------------------
 
 template <typename TResult> class OperationResult
@@ -97,6 +107,8 @@ public:
     const QString& title() const { return _title; }
     CatalogItem* parent() const { return _parent; }
     const QString path() const;
+    // Path including the item's own title, as it's shown to the user
+    QString displayPath() const;
 
     bool isFolder() const;
     bool isMemo() const;
@@ -158,6 +170,7 @@ private:
 typedef OperationResult<int> IntResult;
 typedef OperationResult<MemoItem*> MemoResult;
 typedef OperationResult<FolderItem*> FolderResult;
+typedef OperationResult<QVector<MemoItem*>> MemoListResult;
 typedef OperationResult<Catalog*> CatalorResult;
 
 //------------------------------------------------------------------------------
@@ -189,6 +202,7 @@ public:
     FolderResult createFolder(FolderItem* parent, const QString& title);
     QString removeFolder(FolderItem* item);
     MemoResult createMemo(FolderItem* parent, MemoItem* item, MemoType *memoType);
+    MemoListResult importMemos(FolderItem* parent, const QVector<MemoImportParam>& memos);
     QString updateMemo(MemoItem* item, MemoUpdateParam update);
     QString removeMemo(MemoItem* item);
     QString loadMemo(MemoItem* item);
@@ -200,6 +214,7 @@ signals:
     void memoCreated(MemoItem*);
     void memoRemoved(MemoItem*);
     void memoUpdated(MemoItem*);
+    void memosImported(FolderItem* parent, const QVector<MemoItem*>& items);
 
 private:
     QString _fileName;
@@ -49,4 +49,12 @@ QString openDatabase(const QString fileName)
     return QString();
 }
 
+QString vacuumDatabase()
+{
+    auto res = Ori::Sql::ActionQuery("VACUUM").exec();
+    if (!res.isEmpty())
+        return QString("Failed to vacuum database.\n\n%1").arg(res);
+    return QString();
+}
+
 } // namespace CatalogStore
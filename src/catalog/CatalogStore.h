@@ -12,6 +12,7 @@ FolderManager* folderManager();
 SettingsManager* settingsManager();
 
 QString openDatabase(const QString fileName);
+QString vacuumDatabase();
 
 } // namespace CatalogStore
 
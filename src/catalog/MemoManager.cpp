@@ -39,6 +39,18 @@ public:
         return QString("SELECT Data FROM Memo WHERE Id = %1").arg(id);
     }
 
+    QString sqlSelectIdAndData(const QVector<int>& ids) const {
+        QString sql("SELECT Id, Data FROM Memo");
+        if (!ids.isEmpty())
+        {
+            QStringList idStrs;
+            for (int id : ids)
+                idStrs << QString::number(id);
+            sql += QString(" WHERE Id IN (%1)").arg(idStrs.join(','));
+        }
+        return sql;
+    }
+
     const QString sqlInsert =
         "INSERT INTO Memo (Id, Parent, Title, Type, Data, Created, Updated, Station) "
         "VALUES (:Id, :Parent, :Title, :Type, :Data, :Created, :Updated, :Station)";
@@ -69,6 +81,10 @@ public:
         return QString("SELECT Name, Value from MemoOptions WHERE MemoId = %1").arg(memoId);
     }
 
+    const QString sqlSelectValues(const QString& name) const {
+        return QString("SELECT MemoId, Value from MemoOptions WHERE Name = '%1'").arg(name);
+    }
+
     const QString sqlUpdate =
         "REPLACE INTO MemoOptions (MemoId, Name, Value) VALUES (:MemoId, :Name, :Value)";
 };
@@ -128,6 +144,59 @@ QString MemoManager::create(MemoItem* item) const
     return QString();
 }
 
+QString MemoManager::createAll(const QVector<MemoItem*>& items) const
+{
+    if (items.isEmpty()) return QString();
+
+    auto table = memoTable();
+
+    auto db = QSqlDatabase::database();
+    if (!db.transaction())
+        return QString("Unable to start transaction for importing memos.\n\n%1")
+                .arg(SqlHelper::errorText(db.lastError()));
+
+    SelectQuery queryId(table->sqlSelectMaxId());
+    if (queryId.isFailed() || !queryId.next())
+    {
+        db.rollback();
+        return QString("Unable to generate ids for new memos.\n\n%1").arg(queryId.error());
+    }
+
+    int newId = queryId.record().value(0).toInt() + 1;
+
+    // The statement is prepared once and only rebound for each memo
+    ActionQuery query(table->sqlInsert);
+    for (auto item : items)
+    {
+        item->_id = newId++;
+
+        auto res = query
+                .param(table->parent, item->parent() ? item->parent()->asFolder()->id() : 0)
+                .param(table->id, item->id())
+                .param(table->title, item->title())
+                .param(table->type, item->type()->name())
+                .param(table->data, item->data())
+                .param(table->created, item->created())
+                .param(table->updated, item->updated())
+                .param(table->station, item->station())
+                .exec();
+        if (!res.isEmpty())
+        {
+            db.rollback();
+            return QString("Failed to import memo '%1'.\n\n%2").arg(item->title(), res);
+        }
+    }
+
+    if (!db.commit())
+    {
+        db.rollback();
+        return QString("Unable to commit imported memos.\n\n%1")
+                .arg(SqlHelper::errorText(db.lastError()));
+    }
+
+    return QString();
+}
+
 MemosResult MemoManager::selectAll() const
 {
     auto table = memoTable();
@@ -211,6 +280,26 @@ QString MemoManager::countAll(int *count) const
     return QString();
 }
 
+// Memo data are not stored in memo items, so it's suitable for processing
+// all memos of the catalog without loading all of them into memory at once.
+// Empty memoIds means enumerating of all memos.
+QString MemoManager::enumerateData(const MemoDataVisitor& visitor, const QVector<int>& memoIds) const
+{
+    auto table = memoTable();
+
+    SelectQuery query(table->sqlSelectIdAndData(memoIds), true);
+    if (query.isFailed())
+        return QString("Unable to select memos data.\n\n%1").arg(query.error());
+
+    while (query.next())
+    {
+        auto r = query.record();
+        if (!visitor(r.value(table->id).toInt(), r.value(table->data).toString()))
+            break;
+    }
+    return QString();
+}
+
 QMap<QString, QVariant> MemoManager::selectOptions(int memoId) const
 {
     QMap<QString, QVariant> options;
@@ -232,6 +321,29 @@ QMap<QString, QVariant> MemoManager::selectOptions(int memoId) const
     return options;
 }
 
+// Values of the option for all memos having it, it's for batch jobs
+// not to select options of each memo separately
+QMap<int, QVariant> MemoManager::selectOptionValues(const QString& name) const
+{
+    QMap<int, QVariant> values;
+    auto table = memoOptionsTable();
+
+    SelectQuery query(table->sqlSelectValues(name));
+    if (query.isFailed())
+    {
+        qWarning() << "Unable to select values of memo option" << name << query.error();
+        return values;
+    }
+
+    while (query.next())
+    {
+        auto r = query.record();
+        values[r.value(table->memoId).toInt()] = r.value(table->value);
+    }
+
+    return values;
+}
+
 QString MemoManager::updateOption(int memoId, const QString& name, const QVariant& value) const
 {
     auto table = memoOptionsTable();
@@ -4,6 +4,9 @@
 #include <QString>
 #include <QMap>
 #include <QVariant>
+#include <QVector>
+
+#include <functional>
 
 class MemoItem;
 struct MemoUpdateParam;
@@ -20,18 +23,24 @@ struct MemosResult
     QMap<int, MemoItem*> allMemos;
 };
 
+// Receives memo data while enumerating, return false to stop enumeration
+typedef std::function<bool(int memoId, const QString& data)> MemoDataVisitor;
+
 class MemoManager
 {
 public:
     QString prepare();
 
     QString create(MemoItem* item) const;
+    QString createAll(const QVector<MemoItem*>& items) const;
     QString update(MemoItem *item, const MemoUpdateParam& update) const;
     QString remove(MemoItem* item) const;
     QString load(MemoItem *memo) const;
     MemosResult selectAll() const;
     QString countAll(int* count) const;
+    QString enumerateData(const MemoDataVisitor& visitor, const QVector<int>& memoIds = QVector<int>()) const;
     QMap<QString, QVariant> selectOptions(int memoId) const;
+    QMap<int, QVariant> selectOptionValues(const QString& name) const;
     QString updateOption(int memoId, const QString& name, const QVariant& value) const;
 };
 
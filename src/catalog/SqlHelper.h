@@ -50,8 +50,11 @@ private:
 class SelectQuery
 {
 public:
-    SelectQuery(const QString& sql)
+    SelectQuery(const QString& sql, bool forwardOnly = false)
     {
+        // Forward only query doesn't cache fetched rows, it's useful for
+        // enumerating of large data which are not required to be kept in memory
+        _query.setForwardOnly(forwardOnly);
         if (!_query.exec(sql))
             _error = SqlHelper::errorText(_query, true);
     }
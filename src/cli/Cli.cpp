@@ -0,0 +1,429 @@
+#include "Cli.h"
+
+#include "../catalog/Catalog.h"
+#include "../catalog/CatalogStore.h"
+#include "../import/DirImporter.h"
+#include "../import/EnexImporter.h"
+#include "../TextTokenizer.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QFileInfo>
+#include <QRegularExpression>
+#include <QSet>
+#include <QTextStream>
+
+namespace Cli {
+namespace {
+
+QTextStream& out() { static QTextStream s(stdout); return s; }
+QTextStream& err() { static QTextStream s(stderr); return s; }
+
+int fail(const QString& message)
+{
+    err() << message.trimmed() << '\n';
+    return 1;
+}
+
+struct Command
+{
+    QString name;
+    QString description;
+    int (*exec)(const QCommandLineParser& parser, const QStringList& args);
+    QVector<QPair<QString, QString>> positionals;
+    QList<QCommandLineOption> options;
+};
+
+//------------------------------------------------------------------------------
+//                                  Helpers
+//------------------------------------------------------------------------------
+
+Catalog* openCatalog(const QString& fileName, bool createIfMissing = false)
+{
+    bool exists = QFile::exists(fileName);
+    if (!exists && !createIfMissing)
+    {
+        fail(QString("Notebook file does not exist: %1").arg(fileName));
+        return nullptr;
+    }
+    auto res = exists ? Catalog::open(fileName) : Catalog::create(fileName);
+    if (!res.ok())
+    {
+        fail(res.error());
+        return nullptr;
+    }
+    return res.result();
+}
+
+FolderItem* findFolder(const QList<CatalogItem*>& items, int id)
+{
+    for (auto item : items)
+        if (item->isFolder())
+        {
+            if (item->id() == id) return item->asFolder();
+            auto folder = findFolder(item->asFolder()->children(), id);
+            if (folder) return folder;
+        }
+    return nullptr;
+}
+
+// Returns false if the folder option is set but there is no such folder.
+// Target is null when the option is not set, it means the top level of the catalog.
+bool findTargetFolder(Catalog* catalog, const QCommandLineParser& parser, FolderItem** target)
+{
+    *target = nullptr;
+    if (!parser.isSet("folder")) return true;
+
+    bool ok;
+    int id = parser.value("folder").toInt(&ok);
+    if (ok) *target = findFolder(catalog->items(), id);
+    if (!*target)
+    {
+        fail(QString("Folder not found: %1").arg(parser.value("folder")));
+        return false;
+    }
+    return true;
+}
+
+void collectMemos(const QList<CatalogItem*>& items, QVector<MemoItem*>& memos)
+{
+    for (auto item : items)
+        if (item->isFolder())
+            collectMemos(item->asFolder()->children(), memos);
+        else
+            memos << item->asMemo();
+}
+
+int countFolders(const QList<CatalogItem*>& items)
+{
+    int count = 0;
+    for (auto item : items)
+        if (item->isFolder())
+            count += 1 + countFolders(item->asFolder()->children());
+    return count;
+}
+
+//------------------------------------------------------------------------------
+//                                  export
+//------------------------------------------------------------------------------
+
+QString safeFileName(const QString& title)
+{
+    static const QString forbidden("\\/:*?\"<>|");
+    QString name;
+    name.reserve(title.size());
+    for (auto c : title)
+        name += (c < QChar(' ') || forbidden.contains(c)) ? QChar('_') : c;
+    name = name.left(100).trimmed();
+    while (name.endsWith('.')) name.chop(1);
+    return name.isEmpty() ? QStringLiteral("Untitled") : name;
+}
+
+QString uniqueFileName(const QString& name, const QString& ext, QSet<QString>& usedNames)
+{
+    QString result = name + ext;
+    for (int i = 2; usedNames.contains(result.toLower()); i++)
+        result = QString("%1 (%2)%3").arg(name).arg(i).arg(ext);
+    usedNames.insert(result.toLower());
+    return result;
+}
+
+QString memoFileExt(MemoItem* memo)
+{
+    if (memo->type() == markdownMemoType()) return QStringLiteral(".md");
+    if (memo->type() == richTextMemoType()) return QStringLiteral(".html");
+    return QStringLiteral(".txt");
+}
+
+// Makes directories for folders and assigns a file name for each memo
+QString prepareExport(const QList<CatalogItem*>& items, const QDir& dir, QHash<int, QString>& fileNames)
+{
+    QSet<QString> usedNames;
+    for (auto item : items)
+        if (item->isFolder())
+        {
+            auto name = uniqueFileName(safeFileName(item->title()), QString(), usedNames);
+            if (!dir.mkpath(name))
+                return QString("Unable to create directory %1").arg(dir.filePath(name));
+            auto res = prepareExport(item->asFolder()->children(), QDir(dir.filePath(name)), fileNames);
+            if (!res.isEmpty()) return res;
+        }
+        else
+        {
+            auto memo = item->asMemo();
+            auto name = uniqueFileName(safeFileName(memo->title()), memoFileExt(memo), usedNames);
+            fileNames.insert(memo->id(), dir.filePath(name));
+        }
+    return QString();
+}
+
+int execExport(const QCommandLineParser& parser, const QStringList& args)
+{
+    QScopedPointer<Catalog> catalog(openCatalog(args.at(0)));
+    if (!catalog) return 1;
+
+    FolderItem* folder;
+    if (!findTargetFolder(catalog.data(), parser, &folder)) return 1;
+
+    QDir dir(args.at(1));
+    if (!dir.mkpath("."))
+        return fail(QString("Unable to create directory %1").arg(args.at(1)));
+
+    QHash<int, QString> fileNames;
+    auto res = prepareExport(folder ? folder->children() : catalog->items(), dir, fileNames);
+    if (!res.isEmpty()) return fail(res);
+    if (fileNames.isEmpty())
+    {
+        out() << "Nothing to export\n";
+        return 0;
+    }
+
+    // Memo texts are fetched one by one and are not kept in memory
+    int exported = 0;
+    QString writeError;
+    res = CatalogStore::memoManager()->enumerateData([&](int memoId, const QString& data){
+        if (!fileNames.contains(memoId)) return true;
+        QFile file(fileNames[memoId]);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(data.toUtf8()) < 0)
+        {
+            writeError = QString("Unable to write file %1: %2").arg(file.fileName(), file.errorString());
+            return false;
+        }
+        auto memo = catalog->findMemoById(memoId);
+        if (memo && memo->updated().isValid())
+            file.setFileTime(memo->updated(), QFileDevice::FileModificationTime);
+        exported++;
+        return true;
+    }, folder ? fileNames.keys() : QVector<int>());
+    if (!res.isEmpty()) return fail(res);
+    if (!writeError.isEmpty()) return fail(writeError);
+
+    out() << "Exported memos: " << exported << '\n';
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+//                                  import
+//------------------------------------------------------------------------------
+
+int execImport(const QCommandLineParser& parser, const QStringList& args)
+{
+    QFileInfo source(args.at(1));
+    if (!source.exists())
+        return fail(QString("Source does not exist: %1").arg(args.at(1)));
+    bool isEnex = source.isFile() && source.suffix().compare("enex", Qt::CaseInsensitive) == 0;
+    if (!source.isDir() && !isEnex)
+        return fail("Source must be a directory or an Evernote export file (*.enex)");
+
+    QScopedPointer<Catalog> catalog(openCatalog(args.at(0), true));
+    if (!catalog) return 1;
+
+    FolderItem* target;
+    if (!findTargetFolder(catalog.data(), parser, &target)) return 1;
+
+    auto res = isEnex
+        ? EnexImporter::importFile(catalog.data(), target, source.absoluteFilePath(),
+                                   parser.isSet("plain") ? plainTextMemoType() : markdownMemoType())
+        : DirImporter::importDir(catalog.data(), target, source.absoluteFilePath());
+
+    for (const auto& warning : res.warnings)
+        err() << "Warning: " << warning << '\n';
+
+    out() << "Imported memos: " << res.imported << '\n';
+
+    return res.error.isEmpty() ? 0 : fail(res.error);
+}
+
+//------------------------------------------------------------------------------
+//                                  search
+//------------------------------------------------------------------------------
+
+int execSearch(const QCommandLineParser& parser, const QStringList& args)
+{
+    QRegularExpression::PatternOptions opts;
+    if (!parser.isSet("case-sensitive"))
+        opts |= QRegularExpression::CaseInsensitiveOption;
+    QRegularExpression re(parser.isSet("regex") ? args.at(1) : QRegularExpression::escape(args.at(1)), opts);
+    if (!re.isValid())
+        return fail(QString("Invalid regular expression: %1").arg(re.errorString()));
+    re.optimize();
+
+    QScopedPointer<Catalog> catalog(openCatalog(args.at(0)));
+    if (!catalog) return 1;
+
+    QVector<MemoItem*> memos;
+    collectMemos(catalog->items(), memos);
+
+    QSet<int> found;
+    for (auto memo : memos)
+        if (re.match(memo->title()).hasMatch())
+            found.insert(memo->id());
+
+    if (!parser.isSet("titles"))
+    {
+        auto res = CatalogStore::memoManager()->enumerateData([&](int memoId, const QString& data){
+            if (!found.contains(memoId) && re.match(data).hasMatch())
+                found.insert(memoId);
+            return true;
+        });
+        if (!res.isEmpty()) return fail(res);
+    }
+
+    // Print in the catalog order, not in the order of storing
+    for (auto memo : memos)
+        if (found.contains(memo->id()))
+            out() << memo->id() << '\t' << memo->displayPath() << '\n';
+
+    return found.isEmpty() ? 2 : 0;
+}
+
+//------------------------------------------------------------------------------
+//                                  stats
+//------------------------------------------------------------------------------
+
+int execStats(const QCommandLineParser&, const QStringList& args)
+{
+    QScopedPointer<Catalog> catalog(openCatalog(args.at(0)));
+    if (!catalog) return 1;
+
+    QVector<MemoItem*> memos;
+    collectMemos(catalog->items(), memos);
+
+    QMap<QString, int> typeCounts;
+    for (auto memo : memos)
+        typeCounts[memo->type()->title()]++;
+
+    qint64 chars = 0, words = 0, lines = 0;
+    auto res = CatalogStore::memoManager()->enumerateData([&](int, const QString& data){
+        chars += data.size();
+        words += TextTokenizer::countWords(data);
+        if (!data.isEmpty())
+            lines += data.count('\n') + 1;
+        return true;
+    });
+    if (!res.isEmpty()) return fail(res);
+
+    out() << "File: " << QFileInfo(args.at(0)).absoluteFilePath() << '\n'
+          << "File size: " << QFileInfo(args.at(0)).size() << '\n'
+          << "Folders: " << countFolders(catalog->items()) << '\n'
+          << "Memos: " << memos.size() << '\n';
+    for (auto it = typeCounts.constBegin(); it != typeCounts.constEnd(); it++)
+        out() << "  " << it.key() << ": " << it.value() << '\n';
+    out() << "Characters: " << chars << '\n'
+          << "Words: " << words << '\n'
+          << "Lines: " << lines << '\n';
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+//                                  vacuum
+//------------------------------------------------------------------------------
+
+int execVacuum(const QCommandLineParser&, const QStringList& args)
+{
+    QString fileName = args.at(0);
+    if (!QFile::exists(fileName))
+        return fail(QString("Notebook file does not exist: %1").arg(fileName));
+
+    // There is no need to load catalog items for vacuuming
+    auto res = CatalogStore::openDatabase(fileName);
+    if (!res.isEmpty()) return fail(res);
+
+    qint64 sizeBefore = QFileInfo(fileName).size();
+
+    res = CatalogStore::vacuumDatabase();
+    if (!res.isEmpty()) return fail(res);
+
+    out() << "File size: " << sizeBefore << " -> " << QFileInfo(fileName).size() << '\n';
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+
+const QVector<Command>& commands()
+{
+    static const QString notebookHelp("Notebook file (*.enot).");
+    static const QCommandLineOption folderOption("folder",
+        "Id of the folder to process instead of the whole notebook.", "id");
+    static QVector<Command> commands {
+        { "export", "Exports memos into text files in a directory tree.", execExport,
+          {{"notebook", notebookHelp}, {"dir", "Target directory."}}, {folderOption} },
+        { "import", "Imports a directory of text files or an Evernote export (*.enex). "
+                    "The notebook is created if it does not exist.", execImport,
+          {{"notebook", notebookHelp}, {"source", "Directory or *.enex file."}},
+          {folderOption, {"plain", "Import Evernote notes as plain text instead of markdown."}} },
+        { "search", "Prints ids and paths of memos containing the text. "
+                    "Exit code is 2 when nothing is found.", execSearch,
+          {{"notebook", notebookHelp}, {"text", "Text to search for."}},
+          {{"regex", "Treat the text as a regular expression."},
+           {"case-sensitive", "Do case-sensitive search."},
+           {"titles", "Search in memo titles only."}} },
+        { "stats", "Prints notebook statistics.", execStats,
+          {{"notebook", notebookHelp}}, {} },
+        { "vacuum", "Rebuilds the notebook file to reclaim unused space.", execVacuum,
+          {{"notebook", notebookHelp}}, {} },
+    };
+    return commands;
+}
+
+const Command* findCommand(const QString& name)
+{
+    for (const auto& cmd : commands())
+        if (cmd.name == name)
+            return &cmd;
+    return nullptr;
+}
+
+} // namespace
+
+bool isCommand(int argc, char* argv[])
+{
+    return argc > 1 && findCommand(QString::fromLocal8Bit(argv[1]));
+}
+
+int run(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    app.setApplicationName("Procyon");
+    app.setOrganizationName("orion-project.org");
+    app.setApplicationVersion(APP_VER);
+
+    auto cmd = findCommand(app.arguments().at(1));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(cmd->description);
+    parser.addHelpOption();
+    parser.addOptions(cmd->options);
+    // Command name is the first positional argument, it's here mostly for the usage line
+    parser.addPositionalArgument(cmd->name, QString(), cmd->name);
+    for (const auto& arg : cmd->positionals)
+        parser.addPositionalArgument(arg.first, arg.second);
+
+    // It quits the app when there is --help or unknown options
+    parser.process(app);
+
+    auto args = parser.positionalArguments().mid(1);
+    if (args.size() != cmd->positionals.size())
+    {
+        err() << "Invalid number of arguments\n\n";
+        err().flush();
+        parser.showHelp(1);
+    }
+
+    int res = cmd->exec(parser, args);
+
+    out().flush();
+    err().flush();
+    return res;
+}
+
+QString commandsHelp()
+{
+    QStringList lines {"Commands for using without GUI, run 'procyon <command> --help' for details:"};
+    for (const auto& cmd : commands())
+        lines << QString("  %1  %2").arg(cmd.name, -8).arg(cmd.description);
+    return lines.join('\n');
+}
+
+} // namespace Cli
@@ -0,0 +1,25 @@
+#ifndef CLI_H
+#define CLI_H
+
+#include <QString>
+
+// Headless mode for scripting notebooks:
+//
+//   procyon <command> <notebook> [arguments]
+//
+// Commands are run without creating of QApplication, loading of app settings,
+// stylesheets, and so on, so they start fast and can be used without display.
+namespace Cli {
+
+// Returns true if the first argument is one of known commands.
+bool isCommand(int argc, char* argv[]);
+
+// Runs the command from the command line, returns the process exit code.
+int run(int argc, char* argv[]);
+
+// Short list of available commands for the main help text.
+QString commandsHelp();
+
+} // namespace Cli
+
+#endif // CLI_H
@@ -42,6 +42,12 @@ TextMemoEditor::TextMemoEditor(MemoItem* memoItem, bool createEditor) : MemoEdit
     });
 }
 
+TextMemoEditor::~TextMemoEditor()
+{
+    // Spellcheck results are saved if the memo is closed while editing
+    toggleSpellcheck(false);
+}
+
 void TextMemoEditor::setEditor(MemoTextEdit *editor)
 {
     _editor = editor;
@@ -96,18 +102,28 @@ void TextMemoEditor::toggleSpellcheck(bool on)
 #ifdef ENABLE_SPELLCHECK
     if (on)
     {
-        if (!_spellcheckLang.isEmpty())
+        if (!_spellcheckLang.isEmpty() && !_spellcheck)
         {
-            auto spellchecker = Spellchecker::get(_spellcheckLang);
-            if (!spellchecker) return; // Unable to open dictionary
-            _spellcheck = new TextEditSpellcheck(_editor, spellchecker, this);
-            _spellcheck->spellcheckAll();
+            // Dictionary can be still loading, then the memo is shown without
+            // spellcheck and the spellchecker is attached when it gets ready
+            Spellchecker::request(_spellcheckLang, this, [this](Spellchecker* spellchecker){
+                if (!spellchecker) return; // Unable to open dictionary
+
+                // Things could change while dictionary was loading
+                if (_spellcheck || _editor->isReadOnly() || spellchecker->lang() != _spellcheckLang)
+                    return;
+
+                _spellcheck = new TextEditSpellcheck(_editor, spellchecker, this);
+                _spellcheck->setCacheKey(_spellcheckCacheKey);
+                _spellcheck->spellcheckAll();
+            });
         }
     }
     else
     {
         if (_spellcheck)
         {
+            _spellcheck->saveResults();
             _spellcheck->clearErrorMarks();
             delete _spellcheck;
             _spellcheck = nullptr;
@@ -126,6 +142,14 @@ void TextMemoEditor::setSpellcheckLang(const QString &lang)
         toggleSpellcheck(true);
 }
 
+void TextMemoEditor::setSpellcheckCacheKey(const QString& key)
+{
+    _spellcheckCacheKey = key;
+#ifdef ENABLE_SPELLCHECK
+    if (_spellcheck) _spellcheck->setCacheKey(key);
+#endif
+}
+
 void TextMemoEditor::beginEdit()
 {
     setReadOnly(false);
@@ -172,12 +196,22 @@ void TextMemoEditor::setHighlighterName(const QString& name)
 
     _editor->setUndoRedoEnabled(false);
 
-    if (_highlighter) delete _highlighter;
+    if (_highlighter)
+    {
+        delete _highlighter;
+        _highlighter = nullptr;
+    }
     if (!name.isEmpty())
     {
         auto spec = Ori::Highlighter::getSpec(name);
         if (spec)
+        {
             _highlighter = new Ori::Highlighter::Highlighter(_editor->document(), spec);
+
+            // Large memos are highlighted in background, text scrolled into view goes first
+            auto editor = _editor;
+            _highlighter->followViewport(editor, [editor](const QPoint& pos){ return editor->cursorForPosition(pos).position(); });
+        }
     }
 
     _editor->setUndoRedoEnabled(true);
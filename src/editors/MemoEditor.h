@@ -7,9 +7,10 @@ class MemoItem;
 class MemoTextEdit;
 class TextEditSpellcheck;
 
-QT_BEGIN_NAMESPACE
-class QSyntaxHighlighter;
-QT_END_NAMESPACE
+namespace Ori {
+namespace Highlighter {
+class Highlighter;
+}}
 
 // TODO: all text related options (font, word-wrap, etc.) should be removed
 // from base edior class when non-text memo types will happen
@@ -29,6 +30,7 @@ public:
     virtual QString data() const = 0;
     virtual void setSpellcheckLang(const QString&) = 0;
     virtual QString spellcheckLang() const = 0;
+    virtual void setSpellcheckCacheKey(const QString&) = 0;
     virtual void beginEdit() = 0;
     virtual void endEdit() = 0;
     virtual void saveEdit() = 0;
@@ -58,6 +60,7 @@ public:
     QString data() const override;
     void setSpellcheckLang(const QString& lang) override;
     QString spellcheckLang() const override { return _spellcheckLang; }
+    void setSpellcheckCacheKey(const QString& key) override;
     void beginEdit() override;
     void endEdit() override;
     void saveEdit() override { endEdit(); }
@@ -68,13 +71,15 @@ public:
     void setHighlighterName(const QString& name);
 
     explicit TextMemoEditor(MemoItem* memoItem);
+    ~TextMemoEditor();
 protected:
     explicit TextMemoEditor(MemoItem* memoItem, bool createEditor);
 
     MemoTextEdit* _editor = nullptr;
     TextEditSpellcheck* _spellcheck = nullptr;
     QString _spellcheckLang;
-    QSyntaxHighlighter* _highlighter = nullptr;
+    QString _spellcheckCacheKey;
+    Ori::Highlighter::Highlighter* _highlighter = nullptr;
 
     void setEditor(MemoTextEdit*);
     void setReadOnly(bool on);
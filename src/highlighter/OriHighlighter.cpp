@@ -3,16 +3,27 @@
 
 #include <QActionGroup>
 #include <QApplication>
+#include <QCryptographicHash>
+#include <QDataStream>
 #include <QDir>
 #include <QFile>
+#include <QFileInfo>
 #include <QListWidget>
 #include <QMenu>
 #include <QPlainTextEdit>
 #include <QPushButton>
 #include <QRegularExpression>
+#include <QSaveFile>
+#include <QScrollBar>
+#include <QStandardPaths>
 #include <QTextDocument>
+#include <QTimer>
+#include <QVarLengthArray>
+#include <QtConcurrent>
 #include <QBoxLayout>
 
+#include <algorithm>
+
 #include "orion/helpers/OriDialogs.h"
 
 namespace Ori {
@@ -27,10 +38,323 @@ QString Spec::storableString() const
     return rawCode().trimmed() + "\n\n---\n" + rawSample().trimmed();
 }
 
+//------------------------------------------------------------------------------
+//                                TermMatcher
+//------------------------------------------------------------------------------
+
+// The same chars as \w matches in rules' regexes. They are not created with
+// UseUnicodePropertiesOption, so \w and \b only know ASCII letters and digits.
+static inline bool isWordChar(QChar c)
+{
+    auto u = c.unicode();
+    return (u >= 'a' && u <= 'z') || (u >= 'A' && u <= 'Z') || (u >= '0' && u <= '9') || u == '_';
+}
+
+static inline bool isWordBoundary(const QChar* text, int size, int pos)
+{
+    bool before = pos > 0 && isWordChar(text[pos-1]);
+    bool after = pos < size && isWordChar(text[pos]);
+    return before != after;
+}
+
+static inline quint64 edgeKey(int node, QChar c)
+{
+    return quint64(node) << 16 | c.unicode();
+}
+
+bool TermMatcher::isPlainTerm(const QString& term)
+{
+    static const QString specialChars("\\^$.|?*+()[]{}");
+    if (term.isEmpty()) return false;
+    for (auto c : term)
+        if (specialChars.contains(c))
+            return false;
+    return true;
+}
+
+void TermMatcher::addTerm(const QString& term, int ruleIndex, bool ignoreCase)
+{
+    (ignoreCase ? _caseless : _exact).add(term, ruleIndex, ignoreCase);
+}
+
+void TermMatcher::Trie::add(const QString& term, int ruleIndex, bool ignoreCase)
+{
+    int node = 0;
+    for (auto c : term)
+    {
+        auto key = edgeKey(node, ignoreCase ? c.toCaseFolded() : c);
+        int child = edges.value(key, -1);
+        if (child < 0)
+        {
+            child = nodes.size();
+            nodes.append(QVector<int>());
+            edges.insert(key, child);
+        }
+        node = child;
+    }
+    // The same term can be listed twice
+    if (!nodes.at(node).contains(ruleIndex))
+        nodes[node].append(ruleIndex);
+}
+
+void TermMatcher::Trie::match(const QChar* text, int size, int pos, bool ignoreCase, QVector<Match>& matches) const
+{
+    int node = 0;
+    for (int i = pos; i < size; i++)
+    {
+        auto it = edges.constFind(edgeKey(node, ignoreCase ? text[i].toCaseFolded() : text[i]));
+        if (it == edges.constEnd()) return;
+        node = it.value();
+        const auto& rules = nodes.at(node);
+        if (!rules.isEmpty() && isWordBoundary(text, size, i+1))
+            for (int rule : rules)
+                matches << Match {rule, pos, i+1 - pos};
+    }
+}
+
+void TermMatcher::match(const QString& text, QVector<Match>& matches) const
+{
+    const QChar* data = text.constData();
+    const int size = text.size();
+    const bool hasExact = _exact.nodes.size() > 1;
+    const bool hasCaseless = _caseless.nodes.size() > 1;
+    for (int pos = 0; pos < size; pos++)
+    {
+        // Terms can only start where a word starts (or ends, if a term begins with non-word char)
+        if (!isWordBoundary(data, size, pos)) continue;
+        if (hasExact) _exact.match(data, size, pos, false, matches);
+        if (hasCaseless) _caseless.match(data, size, pos, true, matches);
+    }
+}
+
+//------------------------------------------------------------------------------
+//                              Literal prefilter
+//------------------------------------------------------------------------------
+
+// Returns index after the character class starting at `i`, or -1 if it's not closed
+static int skipCharClass(QStringView p, int i)
+{
+    int n = p.size();
+    int j = i + 1;
+    if (j < n && p[j] == '^') j++;
+    if (j < n && p[j] == ']') j++; // The first ] is literal
+    while (j < n)
+    {
+        if (p[j] == '\\') j += 2;
+        else if (p[j] == '[' && j+1 < n && p[j+1] == ':')
+        {
+            int end = p.indexOf(QLatin1String(":]"), j+2);
+            if (end < 0) return -1;
+            j = end + 2;
+        }
+        else if (p[j] == ']') return j + 1;
+        else j++;
+    }
+    return -1;
+}
+
+// Returns index of the closing parenthesis for the group starting at `i`, or -1.
+// Sets `hasAlternation` if there is | on the top level of the group.
+static int findGroupEnd(QStringView p, int i, bool& hasAlternation)
+{
+    int n = p.size();
+    int depth = 0;
+    hasAlternation = false;
+    int j = i;
+    while (j < n)
+    {
+        QChar c = p[j];
+        if (c == '\\') { j += 2; continue; }
+        if (c == '[')
+        {
+            j = skipCharClass(p, j);
+            if (j < 0) return -1;
+            continue;
+        }
+        if (c == '(') depth++;
+        else if (c == ')')
+        {
+            if (--depth == 0) return j;
+        }
+        else if (c == '|' && depth == 1) hasAlternation = true;
+        j++;
+    }
+    return -1;
+}
+
+// Collects runs of literal chars that any match of the pattern must contain.
+// Everything not understood just ends the current run, and false is returned
+// for constructs after which nothing can be said (alternation, inline options).
+static bool collectLiterals(QStringView p, QStringList& runs)
+{
+    // Escapes standing for a class or an assertion, all other letter escapes are not analyzed
+    static const QString simpleEscapes("dDwWsShHvVbBAzZGRXKnrtfe");
+
+    QString run;
+    auto flush = [&]{
+        if (!run.isEmpty()) runs << run;
+        run.clear();
+    };
+
+    int n = p.size();
+    int i = 0;
+    while (i < n)
+    {
+        QChar c = p[i];
+        QChar literal;
+        bool isLiteral = false;
+        QStringView group;
+        int next;
+
+        if (c == '\\')
+        {
+            if (i+1 >= n) return false;
+            QChar e = p[i+1];
+            if (e.isLetterOrNumber())
+            {
+                if (!simpleEscapes.contains(e)) return false;
+            }
+            else
+            {
+                literal = e;
+                isLiteral = true;
+            }
+            next = i + 2;
+        }
+        else if (c == '[')
+        {
+            next = skipCharClass(p, i);
+            if (next < 0) return false;
+        }
+        else if (c == '(')
+        {
+            bool hasAlternation;
+            int end = findGroupEnd(p, i, hasAlternation);
+            if (end < 0) return false;
+            int bodyStart = i + 1;
+            bool isLookaround = false;
+            if (i+1 < n && p[i+1] == '?')
+            {
+                // Non-capturing groups are analyzed, lookarounds are just skipped
+                auto kind = p.sliced(i+2, qMin(2, n-i-2));
+                if (kind.startsWith(':'))
+                    bodyStart = i + 3;
+                else if (kind.startsWith('=') || kind.startsWith('!') ||
+                         kind == QLatin1String("<=") || kind == QLatin1String("<!"))
+                    isLookaround = true;
+                else
+                    return false;
+            }
+            if (!hasAlternation && !isLookaround)
+                group = p.sliced(bodyStart, end - bodyStart);
+            next = end + 1;
+        }
+        else if (c == '.' || c == '^' || c == '$')
+        {
+            next = i + 1;
+        }
+        else if (c == '|' || c == ')' || c == '*' || c == '+' || c == '?' || c == '{')
+        {
+            return false;
+        }
+        else
+        {
+            literal = c;
+            isLiteral = true;
+            next = i + 1;
+        }
+
+        // Quantifier after the atom
+        bool optional = false;
+        bool repeated = false;
+        if (next < n)
+        {
+            QChar q = p[next];
+            if (q == '*' || q == '?')
+            {
+                optional = true;
+                next++;
+            }
+            else if (q == '+')
+            {
+                repeated = true;
+                next++;
+            }
+            else if (q == '{')
+            {
+                int end = p.indexOf('}', next);
+                if (end < 0) return false;
+                bool ok;
+                int min = p.sliced(next+1, end-next-1).split(',').first().toInt(&ok);
+                if (!ok) return false;
+                optional = min == 0;
+                repeated = min > 0;
+                next = end + 1;
+            }
+            // Lazy or possessive quantifier
+            if ((optional || repeated) && next < n && (p[next] == '?' || p[next] == '+'))
+                next++;
+        }
+
+        if (optional)
+            flush();
+        else if (isLiteral)
+        {
+            // The last repetition is adjacent to what follows, but not to what precedes
+            if (repeated) flush();
+            run += literal;
+        }
+        else
+        {
+            flush();
+            if (!group.isNull() && !collectLiterals(group, runs))
+                return false;
+        }
+        i = next;
+    }
+    flush();
+    return true;
+}
+
+// The longest literal required by the pattern, it's empty if nothing can be found
+static QString requiredLiteral(const QString& pattern, bool ignoreCase)
+{
+    QStringList runs;
+    if (!collectLiterals(pattern, runs)) return QString();
+
+    QString longest;
+    for (const auto& run : runs)
+    {
+        // Case folding of non-ASCII chars could differ from what the regex engine does
+        if (ignoreCase)
+        {
+            bool ascii = true;
+            for (auto c : run)
+                if (c.unicode() >= 128) { ascii = false; break; }
+            if (!ascii) continue;
+        }
+        if (run.size() > longest.size())
+            longest = run;
+    }
+    return longest;
+}
+
 //------------------------------------------------------------------------------
 //                                 SpecLoader
 //------------------------------------------------------------------------------
 
+static int nextSpecVersion()
+{
+    static int lastVersion = 0;
+    return ++lastVersion;
+}
+
+// Multiline rules and rules highlighting a capture group need regexes to work
+static bool usesTermMatcher(const Rule& rule)
+{
+    return !rule.multiline && rule.group == 0;
+}
+
 struct SpecLoader
 {
 private:
@@ -91,9 +415,13 @@ private:
     {
         if (!rule.terms.isEmpty())
         {
+            bool useMatcher = usesTermMatcher(rule);
             rule.exprs.clear();
             for (const auto& term : rule.terms)
-                rule.exprs << QRegularExpression(QString("\\b%1\\b").arg(term));
+                if (useMatcher && TermMatcher::isPlainTerm(term))
+                    spec->terms.addTerm(term, spec->rules.size(), opts.testFlag(QRegularExpression::CaseInsensitiveOption));
+                else
+                    rule.exprs << QRegularExpression(QString("\\b%1\\b").arg(term));
         }
         if (rule.multiline)
         {
@@ -107,8 +435,18 @@ private:
             else if (rule.exprs.size() > 2)
                 rule.exprs.resize(2);
         }
+        bool ignoreCase = opts.testFlag(QRegularExpression::CaseInsensitiveOption);
+        rule.literalCase = ignoreCase ? Qt::CaseInsensitive : Qt::CaseSensitive;
+        rule.literals.clear();
         for (auto& expr : rule.exprs)
+        {
             expr.setPatternOptions(opts);
+            // Only specs parsed from text are compiled and JIT-optimized eagerly: edited specs,
+            // specs stored in the catalog, and spec files missing in SpecFileCache.
+            // Specs read from SpecFileCache are compiled lazily, see there.
+            expr.optimize();
+            rule.literals << requiredLiteral(expr.pattern(), ignoreCase);
+        }
         spec->rules << rule;
     }
 
@@ -160,6 +498,9 @@ public:
         spec->meta.title.clear();
         spec->raw.clear();
         spec->rules.clear();
+        spec->terms = TermMatcher();
+
+        spec->version = nextSpecVersion();
 
         if (!loadMeta(spec->meta, spec))
             return warnings;
@@ -263,6 +604,11 @@ public:
                         rule.multiline = true;
                     else if (s == QStringLiteral("ignore-case"))
                         opts.setFlag(QRegularExpression::CaseInsensitiveOption);
+                    else if (s == QStringLiteral("no-spell"))
+                    {
+                        rule.format.setProperty(NoSpellProperty, true);
+                        rule.noSpell = true;
+                    }
                     else warning(QStringLiteral("Unknown option ") + s);
                 }
             }
@@ -303,6 +649,155 @@ QSharedPointer<Spec> createSpec(const Meta& meta, bool withRawData)
     return spec;
 }
 
+//------------------------------------------------------------------------------
+//                               SpecFileCache
+//------------------------------------------------------------------------------
+
+// Parsed specs are stored in binary form, so spec files don't have to be parsed on each start.
+// Unlike parsing from text, optimize() is not called when a spec is read from the cache,
+// QRegularExpression compiles patterns when they match for the first time, so rules never used cost nothing.
+namespace SpecFileCache {
+
+const quint32 fileMagic = 0x50484C43; // PHLC
+const quint32 fileVersion = 1;
+
+static QString cacheFilePath(const QString& source)
+{
+    auto hash = QCryptographicHash::hash(source.toUtf8(), QCryptographicHash::Md5).toHex();
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/syntax/" + QString::fromLatin1(hash) + ".bin";
+}
+
+// Resources have no meaningful modification time, they are identified by content
+static QString sourceStamp(const QString& source)
+{
+    if (source.startsWith(':'))
+    {
+        QFile file(source);
+        if (!file.open(QFile::ReadOnly)) return QString();
+        return QString::fromLatin1(QCryptographicHash::hash(file.readAll(), QCryptographicHash::Md5).toHex());
+    }
+    QFileInfo file(source);
+    if (!file.exists()) return QString();
+    return QString("%1 %2").arg(file.size()).arg(file.lastModified().toMSecsSinceEpoch());
+}
+
+static bool read(const QString& source, const QString& stamp, Spec* spec, bool metaOnly)
+{
+    QFile file(cacheFilePath(source));
+    if (!file.open(QIODevice::ReadOnly)) return false;
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+
+    quint32 magic, version;
+    QString fileSource, fileStamp;
+    stream >> magic >> version;
+    if (magic != fileMagic || version != fileVersion) return false;
+    stream >> fileSource >> fileStamp;
+    if (fileSource != source || fileStamp != stamp) return false;
+
+    stream >> spec->meta.name >> spec->meta.title;
+    if (metaOnly) return stream.status() == QDataStream::Ok;
+
+    qint32 ruleCount;
+    stream >> ruleCount;
+    for (int i = 0; i < ruleCount && stream.status() == QDataStream::Ok; i++)
+    {
+        Rule rule;
+        QStringList patterns;
+        qint32 patternOptions, literalCase;
+        QTextFormat format;
+        stream >> rule.name >> patterns >> patternOptions >> rule.literals >> literalCase >> format
+               >> rule.terms >> rule.group >> rule.hyperlink >> rule.multiline >> rule.noSpell >> rule.fontSizeDelta;
+        for (const auto& pattern : patterns)
+            rule.exprs << QRegularExpression(pattern, QRegularExpression::PatternOptions(patternOptions));
+        rule.literalCase = Qt::CaseSensitivity(literalCase);
+        rule.format = format.toCharFormat();
+        if (usesTermMatcher(rule))
+            for (const auto& term : rule.terms)
+                if (TermMatcher::isPlainTerm(term))
+                    spec->terms.addTerm(term, i, rule.literalCase == Qt::CaseInsensitive);
+        spec->rules << rule;
+    }
+    if (stream.status() != QDataStream::Ok)
+    {
+        qWarning() << "Unable to read compiled highlighter" << source;
+        spec->rules.clear();
+        spec->terms = TermMatcher();
+        return false;
+    }
+    spec->version = nextSpecVersion();
+    return true;
+}
+
+static void write(const QString& source, const QString& stamp, const Spec& spec)
+{
+    auto filePath = cacheFilePath(source);
+    if (!QDir().mkpath(QFileInfo(filePath).absolutePath())) return;
+
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        qWarning() << "Unable to open file for writing" << filePath << file.errorString();
+        return;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+    stream << fileMagic << fileVersion << source << stamp << spec.meta.name << spec.meta.title;
+    stream << qint32(spec.rules.size());
+    for (const auto& rule : spec.rules)
+    {
+        QStringList patterns;
+        for (const auto& expr : rule.exprs)
+            patterns << expr.pattern();
+        qint32 patternOptions = rule.exprs.isEmpty() ? 0 : qint32(rule.exprs.first().patternOptions());
+        stream << rule.name << patterns << patternOptions << rule.literals << qint32(rule.literalCase)
+               << QTextFormat(rule.format) << rule.terms << rule.group << rule.hyperlink << rule.multiline
+               << rule.noSpell << rule.fontSizeDelta;
+    }
+
+    if (!file.commit())
+        qWarning() << "Unable to write compiled highlighter" << filePath << file.errorString();
+}
+
+// Spec with raw data is only needed for editing, it is always parsed from the file
+static QSharedPointer<Spec> load(const QString& source, bool withRawData, bool metaOnly)
+{
+    QSharedPointer<Spec> spec(new Spec());
+    QString stamp;
+    if (!withRawData)
+    {
+        stamp = sourceStamp(source);
+        if (!stamp.isEmpty() && read(source, stamp, spec.get(), metaOnly))
+            return spec;
+    }
+
+    QFile file(source);
+    if (!file.open(QFile::ReadOnly | QFile::Text))
+    {
+        qWarning() << "Highlighter::SpecFileCache.load" << source << "|" << file.errorString();
+        return QSharedPointer<Spec>();
+    }
+    QTextStream stream(&file);
+    SpecLoader loader(source, stream, withRawData);
+
+    // Only the header is read for meta, rules are compiled
+    // and stored when the highlighter is used for the first time
+    if (metaOnly)
+    {
+        loader.loadMeta(spec->meta);
+        return spec;
+    }
+
+    loader.loadSpec(spec.get());
+    if (!stamp.isEmpty() && !spec->meta.name.isEmpty())
+        write(source, stamp, *spec);
+    return spec;
+}
+
+} // namespace SpecFileCache
+
 //------------------------------------------------------------------------------
 //                               DefaultStorage
 //------------------------------------------------------------------------------
@@ -329,17 +824,10 @@ QVector<Meta> DefaultStorage::loadMetas() const
         if (fileInfo.fileName().endsWith(".phl"))
         {
             auto fileName = fileInfo.absoluteFilePath();
-            QFile file(fileName);
-            if (!file.open(QFile::ReadOnly | QFile::Text))
-            {
-                qWarning() << "Highlighter::DefaultStorage.loadMetas" << fileName << "|" << file.errorString();
-                continue;
-            }
-            QTextStream stream(&file);
-            SpecLoader loader(fileName, stream, false);
-            Meta meta;
-            if (loader.loadMeta(meta))
+            auto spec = SpecFileCache::load(fileName, false, true);
+            if (spec && !spec->meta.name.isEmpty())
             {
+                Meta meta = spec->meta;
                 meta.source = fileName;
                 metas << meta;
             }
@@ -352,17 +840,7 @@ QVector<Meta> DefaultStorage::loadMetas() const
 
 QSharedPointer<Spec> DefaultStorage::loadSpec(const Meta &meta, bool withRawData) const
 {
-    QFile file(meta.source);
-    if (!file.open(QFile::ReadOnly | QFile::Text))
-    {
-        qWarning() << "Highlighter::DefaultStorage.loadSpec" << meta.source << "|" << file.errorString();
-        return QSharedPointer<Spec>();
-    }
-    QTextStream stream(&file);
-    QSharedPointer<Spec> spec(new Spec());
-    SpecLoader loader(meta.source, stream, withRawData);
-    loader.loadSpec(spec.get());
-    return spec;
+    return SpecFileCache::load(meta.source, withRawData, false);
 }
 
 QString DefaultStorage::saveSpec(const QSharedPointer<Spec>& spec)
@@ -393,17 +871,10 @@ QVector<Meta> QrcStorage::loadMetas() const
 
     for (const auto& fileName : files)
     {
-        QFile file(fileName);
-        if (!file.open(QFile::ReadOnly | QFile::Text))
-        {
-            qWarning() << "Highlighter::QrcStorage.loadMetas" << fileName << "|" << file.errorString();
-            continue;
-        }
-        QTextStream stream(&file);
-        SpecLoader loader(fileName, stream, false);
-        Meta meta;
-        if (loader.loadMeta(meta))
+        auto spec = SpecFileCache::load(fileName, false, true);
+        if (spec && !spec->meta.name.isEmpty())
         {
+            Meta meta = spec->meta;
             meta.source = fileName;
             metas << meta;
         }
@@ -415,17 +886,7 @@ QVector<Meta> QrcStorage::loadMetas() const
 
 QSharedPointer<Spec> QrcStorage::loadSpec(const Meta &meta, bool withRawData) const
 {
-    QFile file(meta.source);
-    if (!file.open(QFile::ReadOnly | QFile::Text))
-    {
-        qWarning() << "Highlighter::QrcStorage.loadSpec" << meta.source << "|" << file.errorString();
-        return QSharedPointer<Spec>();
-    }
-    QTextStream stream(&file);
-    QSharedPointer<Spec> spec(new Spec());
-    SpecLoader loader(meta.source, stream, withRawData);
-    loader.loadSpec(spec.get());
-    return spec;
+    return SpecFileCache::load(meta.source, withRawData, false);
 }
 
 //------------------------------------------------------------------------------
@@ -434,13 +895,59 @@ QSharedPointer<Spec> QrcStorage::loadSpec(const Meta &meta, bool withRawData) co
 
 struct SpecCache
 {
+    QVector<QSharedPointer<SpecStorage>> storages;
     QMap<QString, Meta> allMetas;
     QMap<QString, QSharedPointer<Spec>> loadedSpecs;
     QSharedPointer<SpecStorage> customStorage;
+    bool metasLoaded = false;
+
+    void setStorages(const QVector<QSharedPointer<SpecStorage>>& newStorages)
+    {
+        storages = newStorages;
+        allMetas.clear();
+        loadedSpecs.clear();
+        customStorage.reset();
+        metasLoaded = false;
+
+        // The first writable storage becomes a default storage
+        // for new highlighters, this is enough for now
+        for (const auto& storage : storages)
+            if (!storage->readOnly())
+            {
+                customStorage = storage;
+                break;
+            }
+    }
+
+    // Metas are loaded on first demand (opening a memo with highlighter, showing the menu, etc.)
+    // rather than when a catalog is opened, it requires reading of all highlighter files
+    const QMap<QString, Meta>& metas()
+    {
+        if (metasLoaded) return allMetas;
+        metasLoaded = true;
+
+        for (const auto& storage : storages)
+        {
+            for (auto& meta : storage->loadMetas())
+            {
+                if (allMetas.contains(meta.name))
+                {
+                    const auto& existedMeta = allMetas[meta.name];
+                    qWarning() << "Highlighter is already registered" << existedMeta.name << existedMeta.source
+                               << (existedMeta.storage ? existedMeta.storage->name() : QString("null-storage"));
+                    continue;
+                }
+                meta.storage = storage;
+                allMetas[meta.name] = meta;
+                qDebug() << "Highlighter registered" << meta.name << meta.source << meta.storage->name();
+            }
+        }
+        return allMetas;
+    }
 
     QSharedPointer<Spec> getSpec(QString name)
     {
-        if (!allMetas.contains(name))
+        if (!metas().contains(name))
         {
             qWarning() << "Highlighters::SpecCache: unknown name" << name;
             return QSharedPointer<Spec>();
@@ -476,7 +983,7 @@ QPair<bool, bool> checkDuplicates(const Meta& meta)
 {
     bool name = false;
     bool title = false;
-    const auto& metas = specCache().allMetas;
+    const auto& metas = specCache().metas();
     auto it = metas.constBegin();
     while (it != metas.constEnd())
     {
@@ -499,130 +1006,503 @@ QPair<bool, bool> checkDuplicates(const Meta& meta)
 //                                 Highlighter
 //------------------------------------------------------------------------------
 
+namespace {
+// Time given to highlighting in one go, when a document is opened or changed
+// and then in each idle slice, the editor doesn't feel frozen while it's short
+const int passBudgetMs = 30;
+const int sliceBudgetMs = 10;
+}
+
 QSyntaxHighlighter* createHighlighter(QPlainTextEdit* editor, const QString& name)
 {
     auto hl = Ori::Highlighter::getSpec(name);
-    return hl ? new Highlighter(editor->document(), hl) : nullptr;
+    if (!hl) return nullptr;
+
+    auto highlighter = new Highlighter(editor->document(), hl);
+    highlighter->followViewport(editor, [editor](const QPoint& pos){ return editor->cursorForPosition(pos).position(); });
+    return highlighter;
 }
 
 Highlighter::Highlighter(QTextDocument *parent, const QSharedPointer<Spec>& spec)
-    : QSyntaxHighlighter(parent), _spec(spec), _document(parent)
+    : QSyntaxHighlighter(static_cast<QObject*>(parent)), _spec(spec), _document(parent)
 {
     setObjectName(spec->meta.name);
+
+    _sliceTimer = new QTimer(this);
+    _sliceTimer->setInterval(0);
+    connect(_sliceTimer, &QTimer::timeout, this, &Highlighter::highlightSlice);
+
+    // Connected before QSyntaxHighlighter gets the document,
+    // so the deferred region is adjusted before changed blocks are highlighted
+    _revision = parent->revision();
+    connect(parent, &QTextDocument::contentsChange, this, &Highlighter::documentChanged);
+    setDocument(parent);
 }
 
-void Highlighter::highlightBlock(const QString &text)
+Highlighter::~Highlighter()
 {
-    bool hasMultilines = false;
-    for (const auto& rule : _spec->rules)
+    // Results are not needed anymore, parts not started yet are dropped
+    if (_precomputing)
     {
-        if (rule.multiline && rule.exprs.size() >= 1)
+        _precomputing->cancel();
+        _precomputing->waitForFinished();
+    }
+}
+
+// QSyntaxHighlighter calls highlightBlock for all changed blocks in a row and there is no
+// way to interrupt it. So when it takes too long, the rest of blocks are just left as is.
+bool Highlighter::deferBlock()
+{
+    auto block = currentBlock();
+    if (block == _forced) return false;
+
+    // Text on the screen is highlighted regardless of time, only the rest is deferred
+    if (block.position() <= _visibleStop && block.position() + block.length() > _visibleStart)
+        return false;
+
+    if (!_deferred.isNull() && block.position() >= _deferred.position())
+        return true;
+
+    // All blocks of a pass are highlighted before the event loop continues
+    if (!_passTime.isValid())
+    {
+        _passTime.start();
+        QTimer::singleShot(0, this, [this]{ _passTime.invalidate(); });
+    }
+    if (_passTime.elapsed() < passBudgetMs)
+        return false;
+
+    _deferred = QTextCursor(block);
+    // Blocks are collected when the pass is over, the document can't be read inside of it
+    QTimer::singleShot(0, this, &Highlighter::startPrecompute);
+    return true;
+}
+
+namespace {
+
+// Formats of a block with the hash of what they were computed from
+struct BlockFormatsData : public QTextBlockUserData
+{
+    bool isValid = false;
+    // Formats are set to the block, it's false while the block waits in the deferred region
+    bool isApplied = false;
+    size_t hash = 0;
+    BlockFormats formats;
+};
+
+// Parallel computing is only worth it for large documents
+const int minPrecomputeBlocks = 1000;
+const int precomputePartSize = 500;
+
+struct PrecomputePart
+{
+    int firstNumber;
+    int firstState;
+    QStringList texts;
+};
+
+} // namespace
+
+// Blocks are split into parts matched in parallel. Incoming state of a part is not known
+// until the previous part is done, so parts except the first one are matched as if nothing
+// continues from before. A block matched with the wrong incoming state is just matched
+// again when it's applied, and usually that only happens for the first block of a part.
+void Highlighter::startPrecompute()
+{
+    if (_deferred.isNull() || _precomputing) return;
+
+    auto first = _deferred.block();
+    if (_document->blockCount() - first.blockNumber() < minPrecomputeBlocks)
+    {
+        _sliceTimer->start();
+        return;
+    }
+
+    QVector<PrecomputePart> parts;
+    auto prev = first.previous();
+    int state = prev.isValid() ? prev.userState() : -1;
+    for (auto block = first; block.isValid(); block = block.next())
+    {
+        if (parts.isEmpty() || parts.last().texts.size() >= precomputePartSize)
         {
-            hasMultilines = true;
-            continue;
+            parts << PrecomputePart {block.blockNumber(), state, {}};
+            state = -1;
         }
-        for (const auto& expr : rule.exprs)
-        {
-            auto m = expr.match(text);
-            while (m.hasMatch())
-            {
-                int pos = m.capturedStart(rule.group);
-                int length = m.capturedLength(rule.group);
+        parts.last().texts << block.text();
+    }
 
-                // Font style is applied correctly but highlighter can't make anchors and apply tooltips.
-                // We do it manually overriding event handlers in MemoEditor.
-                // There is the bug but seems nobody cares: https://bugreports.qt.io/browse/QTBUG-21553
-                if (rule.hyperlink)
-                {
-                    QTextCharFormat format(rule.format);
-                    format.setAnchorHref(m.captured(rule.group));
-                    setFormat(pos, length, format);
-                }
-                else if (rule.fontSizeDelta != 0)
-                {
-                    QTextCharFormat format(rule.format);
-                    format.setFontPointSize(_document->defaultFont().pointSize() + rule.fontSizeDelta);
-                    setFormat(pos, length, format);
-                }
-                else
-                    setFormat(pos, length, rule.format);
-                m = expr.match(text, pos + length);
+    QVector<int> firstNumbers;
+    for (const auto& part : parts)
+        firstNumbers << part.firstNumber;
+
+    auto spec = _spec;
+    _precomputing = new QFutureWatcher<QVector<Precomputed>>(this);
+    connect(_precomputing, &QFutureWatcherBase::finished, this, [this, firstNumbers]{
+        auto future = _precomputing->future();
+        if (!future.isCanceled())
+            for (int i = 0; i < future.resultCount(); i++)
+            {
+                const auto& blocks = future.resultAt(i);
+                for (int j = 0; j < blocks.size(); j++)
+                    _precomputed.insert(firstNumbers.at(i) + j, blocks.at(j));
             }
+        _precomputing->deleteLater();
+        _precomputing = nullptr;
+        _sliceTimer->start();
+    });
+    _precomputing->setFuture(QtConcurrent::mapped(parts, [spec](const PrecomputePart& part){
+        QVector<Precomputed> blocks;
+        blocks.reserve(part.texts.size());
+        int state = part.firstState;
+        for (const auto& text : part.texts)
+        {
+            auto formats = BlockFormats::match(*spec, text, state);
+            int nextState = formats.state;
+            blocks << Precomputed {text, state, formats};
+            state = nextState;
         }
+        return blocks;
+    }));
+}
+
+// Deferred blocks are highlighted in order, so multiline states come to them correctly
+void Highlighter::highlightSlice()
+{
+    QElapsedTimer time;
+    time.start();
+
+    auto block = _deferred.block();
+    while (block.isValid() && time.elapsed() < sliceBudgetMs)
+    {
+        auto next = block.next();
+
+        // The block leaves the deferred region before it's highlighted. When its state changes,
+        // QSyntaxHighlighter goes to the next block, but that one is still deferred and skipped.
+        if (next.isValid())
+            _deferred.setPosition(next.position());
+        _forced = block;
+        rehighlightBlock(block);
+        _forced = QTextBlock();
+
+        block = next;
     }
-    if (hasMultilines)
+    if (!block.isValid())
     {
-        int offset = 0;
-        setCurrentBlockState(-1);
-        int size = _spec->rules.size();
-        for (int i = 0; i < size; i++)
+        _deferred = QTextCursor();
+        _precomputed.clear();
+        _sliceTimer->stop();
+    }
+}
+
+// The deferred region starts at a cursor, so it follows edits by itself. Precomputed results
+// are keyed by block numbers, which can be shifted by edits, so they are dropped.
+void Highlighter::documentChanged(int position, int charsRemoved, int charsAdded)
+{
+    Q_UNUSED(charsRemoved)
+
+    // Formats applied by highlighting emit the signal too, but they don't change revision
+    if (_document->revision() == _revision) return;
+    _revision = _document->revision();
+
+    if (_deferred.isNull()) return;
+
+    _precomputed.clear();
+    if (_precomputing)
+        _precomputing->cancel();
+
+    // When the change covers the start of the region, the cursor collapses into the changed text.
+    // Changed blocks are highlighted by the pass coming after this signal, the region goes after them.
+    // Changes inside of the region are left for slices, unless they are on the screen.
+    if (position <= _deferred.position() && position + charsAdded >= _deferred.position())
+    {
+        auto next = _document->findBlock(position + charsAdded).next();
+        if (next.isValid())
+            _deferred.setPosition(next.position());
+        else
+            _deferred = QTextCursor();
+    }
+}
+
+void Highlighter::highlightRange(int startPos, int stopPos)
+{
+    _visibleStart = startPos;
+    _visibleStop = stopPos;
+
+    if (_deferred.isNull()) return;
+
+    // Multiline state of these blocks can be wrong, they are highlighted again when their turn comes
+    auto block = _document->findBlock(qMax(startPos, _deferred.position()));
+    while (block.isValid() && block.position() <= stopPos)
+    {
+        _forced = block;
+        rehighlightBlock(block);
+        _forced = QTextBlock();
+        block = block.next();
+    }
+}
+
+bool Highlighter::isHighlighted(const QTextBlock& block) const
+{
+    auto data = static_cast<BlockFormatsData*>(block.userData());
+    return data && data->isApplied;
+}
+
+void Highlighter::followViewport(QAbstractScrollArea* editor, const std::function<int(const QPoint&)>& positionAt)
+{
+    _viewport = editor->viewport();
+    _positionAt = positionAt;
+    _viewport->installEventFilter(this);
+    connect(editor->verticalScrollBar(), &QScrollBar::valueChanged, this, &Highlighter::highlightViewport);
+
+    // The first pass goes after the event loop continues, the visible range is known by then
+    highlightViewport();
+}
+
+void Highlighter::highlightViewport()
+{
+    if (_viewport)
+        highlightRange(_positionAt(QPoint(0, 0)), _positionAt(QPoint(_viewport->width(), _viewport->height())));
+}
+
+bool Highlighter::eventFilter(QObject* obj, QEvent* event)
+{
+    // Growing viewport reveals text below which can still be deferred
+    if (obj == _viewport && event->type() == QEvent::Resize)
+        highlightViewport();
+    return QSyntaxHighlighter::eventFilter(obj, event);
+}
+
+void Highlighter::highlightBlock(const QString &text)
+{
+    if (deferBlock())
+    {
+        // QSyntaxHighlighter clears formats of the block as nothing is set to it
+        if (auto data = static_cast<BlockFormatsData*>(currentBlockUserData()))
+            data->isApplied = false;
+        return;
+    }
+
+    // Document-wide events (rehighlighting, font change, undo of large edits) make
+    // QSyntaxHighlighter go through all blocks, but most of them are the same as before,
+    // so their formats are taken from the block rather than matched again
+    int previousState = previousBlockState();
+    size_t hash = qHashMulti(0, text, previousState, _spec->version);
+    auto data = static_cast<BlockFormatsData*>(currentBlockUserData());
+    if (!data)
+    {
+        data = new BlockFormatsData;
+        setCurrentBlockUserData(data);
+    }
+    if (!data->isValid || data->hash != hash)
+    {
+        auto it = _precomputed.constFind(currentBlock().blockNumber());
+        if (it != _precomputed.constEnd() && it->previousState == previousState && it->text == text)
+            data->formats = it->formats;
+        else
+            data->formats = BlockFormats::match(*_spec, text, previousState);
+        data->hash = hash;
+        data->isValid = true;
+    }
+    const auto& formats = data->formats;
+
+    const auto& ruleFormats = this->ruleFormats();
+    for (const auto& span : formats.spans)
+    {
+        // Font style is applied correctly but highlighter can't make anchors and apply tooltips.
+        // We do it manually overriding event handlers in MemoEditor.
+        // There is the bug but seems nobody cares: https://bugreports.qt.io/browse/QTBUG-21553
+        if (_spec->rules.at(span.rule).hyperlink)
         {
-            const auto& rule = _spec->rules.at(i);
-            if (!rule.multiline) continue;
-            offset = matchMultiline(text, rule, i, offset);
-            if (offset < 0) break;
+            QTextCharFormat format(ruleFormats.at(span.rule));
+            format.setAnchorHref(span.href);
+            setFormat(span.start, span.length, format);
         }
+        else
+            setFormat(span.start, span.length, ruleFormats.at(span.rule));
     }
+    setCurrentBlockState(formats.state);
+    data->isApplied = true;
 }
 
-int Highlighter::matchMultiline(const QString &text, const Rule& rule, int ruleIndex, int initialOffset)
+// Formats depending on the document are made once rather than for each match,
+// they are only made again if the document's font size changes
+const QVector<QTextCharFormat>& Highlighter::ruleFormats()
+{
+    int pointSize = _document->defaultFont().pointSize();
+    if (_ruleFormats.size() == _spec->rules.size() && _ruleFormatsPointSize == pointSize)
+        return _ruleFormats;
+
+    _ruleFormats.clear();
+    for (const auto& rule : _spec->rules)
+    {
+        QTextCharFormat format(rule.format);
+        if (rule.fontSizeDelta != 0)
+            format.setFontPointSize(pointSize + rule.fontSizeDelta);
+        _ruleFormats << format;
+    }
+    _ruleFormatsPointSize = pointSize;
+    return _ruleFormats;
+}
+
+//------------------------------------------------------------------------------
+//                                BlockFormats
+//------------------------------------------------------------------------------
+
+static int matchMultiline(const QString &text, const Rule& rule, int ruleIndex,
+                          int initialOffset, int previousState, BlockFormats& result)
 {
     const auto& exprBeg = rule.exprs[0];
     const auto& exprEnd = rule.exprs[1];
     QRegularExpressionMatch m;
 
-    //qDebug() << rule.name << previousBlockState() << "|" << initialOffset << "|" << text;
-
     int start = 0;
     int offset = initialOffset;
-    bool matchEnd = previousBlockState() == ruleIndex;
+    bool matchEnd = previousState == ruleIndex;
     while (true)
     {
-        m = (matchEnd ? exprEnd : exprBeg).match(text, offset);
+        int exprIndex = matchEnd ? 1 : 0;
+        if (rule.mayMatch(exprIndex, text))
+            m = (matchEnd ? exprEnd : exprBeg).match(text, offset);
+        else
+            m = QRegularExpressionMatch();
         if (m.hasMatch())
         {
             if (matchEnd)
             {
-                setFormat(start, m.capturedEnd()-start, rule.format);
-                setCurrentBlockState(-1);
+                result.spans << BlockFormats::Span {ruleIndex, start, int(m.capturedEnd()) - start, QString()};
+                result.state = -1;
                 matchEnd = false;
-                //qDebug() << "    has-match(end)" << start << m.capturedEnd()-start;
             }
             else
             {
                 start = m.capturedStart();
                 matchEnd = true;
-                //qDebug() << "    has-match(beg)" << start;
             }
             offset = m.capturedEnd();
-            //qDebug() << "    offset" << offset;
         }
         else
         {
             if (matchEnd)
             {
-                //qDebug() << "    no-match(end)" << start << text.length()-start;
-                setFormat(start, text.length()-start, rule.format);
-                setCurrentBlockState(ruleIndex);
+                result.spans << BlockFormats::Span {ruleIndex, start, int(text.length()) - start, QString()};
+                result.state = ruleIndex;
                 offset = -1;
             }
-            else
-            {
-                //qDebug() << "    no-match(beg)";
-            }
             break;
         }
     }
-    //qDebug() << "    return" << offset;
     return offset;
 }
 
+BlockFormats BlockFormats::match(const Spec& spec, const QString& text, int previousState)
+{
+    BlockFormats result;
+
+    // Terms of all rules are found at once, then they are applied
+    // in order of rules, so later rules still override earlier ones
+    QVector<TermMatcher::Match> terms;
+    if (!spec.terms.isEmpty())
+    {
+        spec.terms.match(text, terms);
+        std::stable_sort(terms.begin(), terms.end(), [](const TermMatcher::Match& a, const TermMatcher::Match& b){
+            return a.rule < b.rule;
+        });
+    }
+    auto term = terms.cbegin();
+
+    bool hasMultilines = false;
+    int size = spec.rules.size();
+    for (int i = 0; i < size; i++)
+    {
+        const auto& rule = spec.rules.at(i);
+        for (; term != terms.cend() && term->rule == i; term++)
+            result.spans << Span {i, term->pos, term->length,
+                rule.hyperlink ? text.mid(term->pos, term->length) : QString()};
+
+        if (rule.multiline && rule.exprs.size() >= 1)
+        {
+            hasMultilines = true;
+            continue;
+        }
+        for (int j = 0; j < rule.exprs.size(); j++)
+        {
+            // Most rules can't match on most lines, e.g. there is no # for a comment,
+            // and searching for a literal is much cheaper than running the regex
+            if (!rule.mayMatch(j, text)) continue;
+
+            const auto& expr = rule.exprs.at(j);
+            auto m = expr.match(text);
+            while (m.hasMatch())
+            {
+                int pos = m.capturedStart(rule.group);
+                int length = m.capturedLength(rule.group);
+                result.spans << Span {i, pos, length, rule.hyperlink ? m.captured(rule.group) : QString()};
+                m = expr.match(text, pos + length);
+            }
+        }
+    }
+    if (hasMultilines)
+    {
+        int offset = 0;
+        for (int i = 0; i < size; i++)
+        {
+            const auto& rule = spec.rules.at(i);
+            if (!rule.multiline) continue;
+            offset = matchMultiline(text, rule, i, offset, previousState, result);
+            if (offset < 0) break;
+        }
+    }
+    result.resolveOverlaps(text.size());
+    return result;
+}
+
+// Each char gets the format of the last span covering it, the same as if spans were applied
+// one by one, and then neighbor chars of the same format are joined into a single span.
+void BlockFormats::resolveOverlaps(int textLength)
+{
+    if (spans.isEmpty()) return;
+
+    QVarLengthArray<int, 256> owners(textLength);
+    std::fill(owners.begin(), owners.end(), -1);
+    for (int i = 0; i < spans.size(); i++)
+    {
+        const auto& span = spans.at(i);
+        int start = qMax(span.start, 0);
+        int stop = qMin(span.start + span.length, textLength);
+        for (int pos = start; pos < stop; pos++)
+            owners[pos] = i;
+    }
+
+    auto sameFormat = [this](int a, int b){
+        if (a == b) return true;
+        if (a < 0 || b < 0) return false;
+        return spans.at(a).rule == spans.at(b).rule && spans.at(a).href == spans.at(b).href;
+    };
+
+    QVector<Span> resolved;
+    int pos = 0;
+    while (pos < textLength)
+    {
+        int owner = owners[pos];
+        int start = pos;
+        while (pos < textLength && sameFormat(owners[pos], owner))
+            pos++;
+        if (owner >= 0)
+        {
+            const auto& span = spans.at(owner);
+            resolved << Span {span.rule, start, pos - start, span.href};
+        }
+    }
+    spans = resolved;
+}
+
 //------------------------------------------------------------------------------
 //                                 Control
 //------------------------------------------------------------------------------
 
 Control::Control(QMenu *menu, QObject *parent) : QObject(parent), _menu(menu)
 {
+    connect(_menu, &QMenu::aboutToShow, this, &Control::makeMenu);
 }
 
 void Control::loadMetas(const QVector<QSharedPointer<SpecStorage>>& storages)
@@ -630,46 +1510,29 @@ void Control::loadMetas(const QVector<QSharedPointer<SpecStorage>>& storages)
     if (_managerDlg)
         _managerDlg->close();
 
-    auto& cache = specCache();
-    cache.allMetas.clear();
-    cache.loadedSpecs.clear();
-    for (const auto& storage : storages)
-    {
-        // The first writable storage becomes a default storage
-        // for new highlighters, this is enough for now
-        if (!storage->readOnly() && !cache.customStorage)
-            cache.customStorage = storage;
+    specCache().setStorages(storages);
 
-        for (auto& meta : storage->loadMetas())
-        {
-            if (cache.allMetas.contains(meta.name))
-            {
-                const auto& existedMeta = cache.allMetas[meta.name];
-                qWarning() << "Highlighter is already registered" << existedMeta.name << existedMeta.source
-                           << (existedMeta.storage ? existedMeta.storage->name() : QString("null-storage"));
-                continue;
-            }
-            meta.storage = storage;
-            cache.allMetas[meta.name] = meta;
-            qDebug() << "Highlighter registered" << meta.name << meta.source << meta.storage->name();
-        }
+    // The menu is rebuilt when it's shown next time
+    if (_actionGroup)
+    {
+        delete _actionGroup;
+        _actionGroup = nullptr;
     }
-
-    makeMenu();
 }
 
 void Control::makeMenu()
 {
-    if (_actionGroup) delete _actionGroup;
+    if (_actionGroup) return;
 
     _actionGroup = new QActionGroup(this);
+    _actionGroup->setEnabled(_enabled);
     connect(_actionGroup, &QActionGroup::triggered, this, &Control::actionGroupTriggered);
 
     auto actionNone = new QAction(tr("None"), this);
     actionNone->setCheckable(true);
     _actionGroup->addAction(actionNone);
 
-    const auto& allMetas = specCache().allMetas;
+    const auto& allMetas = specCache().metas();
     auto it = allMetas.constBegin();
     while (it != allMetas.constEnd())
     {
@@ -686,7 +1549,7 @@ void Control::makeMenu()
 
 void Control::showCurrent(const QString& name)
 {
-    if (!_actionGroup) return;
+    makeMenu();
     for (const auto& action : _actionGroup->actions())
         if (action->data().toString() == name)
         {
@@ -695,9 +1558,11 @@ void Control::showCurrent(const QString& name)
         }
 }
 
+// The menu is not made here, it would require loading of all metas
 void Control::setEnabled(bool on)
 {
-    _actionGroup->setEnabled(on);
+    _enabled = on;
+    if (_actionGroup) _actionGroup->setEnabled(on);
 }
 
 void Control::actionGroupTriggered(QAction* action)
@@ -724,8 +1589,9 @@ ManagerDlg::ManagerDlg(Control *parent) : QWidget(), _parent(parent)
 
     _specList = new QListWidget;
     _specList->setObjectName("pages_list");
-    auto it = specCache().allMetas.constBegin();
-    while (it != specCache().allMetas.constEnd())
+    const auto& metas = specCache().metas();
+    auto it = metas.constBegin();
+    while (it != metas.constEnd())
     {
         const auto& meta = it.value();
         QString title = meta.displayTitle();
@@ -782,7 +1648,7 @@ void ManagerDlg::editHighlighter()
     if (name.isEmpty())
         return Ori::Dlg::info(tr("No highlighter is selected"));
 
-    const auto& meta = cache.allMetas[name];
+    const auto meta = cache.metas()[name];
     if (!meta.storage)
         return Ori::Dlg::warning(tr("Hihghlighter storage is not set"));
 
@@ -822,7 +1688,7 @@ void ManagerDlg::createHighlighterCopy()
     if (name.isEmpty())
         return Ori::Dlg::info(tr("No highlighter is selected"));
 
-    const auto& meta = cache.allMetas[name];
+    const auto meta = cache.metas()[name];
     if (!meta.storage)
         return Ori::Dlg::warning(tr("Hihghlighter storage is not set"));
 
@@ -852,7 +1718,7 @@ void ManagerDlg::deleteHighlighter()
     if (name.isEmpty())
         return Ori::Dlg::info(tr("No highlighter is selected"));
 
-    const auto& meta = cache.allMetas[name];
+    const auto meta = cache.metas()[name];
     if (!meta.storage)
         return Ori::Dlg::warning(tr("Hihghlighter storage is not set"));
 
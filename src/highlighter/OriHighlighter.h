@@ -1,12 +1,20 @@
 #ifndef ORI_HIGHLIGHTER_H
 #define ORI_HIGHLIGHTER_H
 
+#include <QElapsedTimer>
+#include <QFutureWatcher>
+#include <QHash>
+#include <QPointer>
 #include <QWidget>
 #include <QRegularExpression>
 #include <QSyntaxHighlighter>
 
+#include <functional>
+
 QT_BEGIN_NAMESPACE
+class QAbstractScrollArea;
 class QActionGroup;
+class QTimer;
 class QListWidget;
 class QMenu;
 class QPlainTextEdit;
@@ -31,16 +39,73 @@ struct Meta
 };
 
 
+// Custom properties set to formats produced by highlighter,
+// they can be read back by other document consumers via block layout formats
+enum FormatProperty
+{
+    // Text is not natural language (code, commands, etc.) and should not be spellchecked
+    NoSpellProperty = QTextFormat::UserProperty + 1,
+};
+
+
 struct Rule
 {
     QString name;
     QVector<QRegularExpression> exprs;
+    // Text each of exprs requires to match, empty if it can't be deduced from the pattern
+    QStringList literals;
+    Qt::CaseSensitivity literalCase = Qt::CaseSensitive;
     QTextCharFormat format;
     QStringList terms;
     int group = 0;
     bool hyperlink = false;
     bool multiline = false;
+    bool noSpell = false;
     int fontSizeDelta = 0;
+
+    // Cheap check if the expression can match in the text at all
+    bool mayMatch(int exprIndex, const QString& text) const
+    {
+        const auto& literal = literals.at(exprIndex);
+        return literal.isEmpty() || text.contains(literal, literalCase);
+    }
+};
+
+
+// Terms of all rules of a spec compiled into a trie, so that keywords are found
+// in a single pass over a block instead of running a separate regex for each term.
+// A term is only matched as a whole word, the same as \bterm\b expression does.
+class TermMatcher
+{
+public:
+    struct Match
+    {
+        int rule;
+        int pos;
+        int length;
+    };
+
+    // Only plain words can be added, terms containing regex syntax are still matched by regexes
+    static bool isPlainTerm(const QString& term);
+    void addTerm(const QString& term, int ruleIndex, bool ignoreCase);
+    bool isEmpty() const { return _exact.nodes.size() <= 1 && _caseless.nodes.size() <= 1; }
+
+    // Matches are appended in order of their positions
+    void match(const QString& text, QVector<Match>& matches) const;
+
+private:
+    struct Trie
+    {
+        // Rules where the term ending at the node belongs to, the first node is root
+        QVector<QVector<int>> nodes {QVector<int>()};
+        // Child nodes, the key is parent node index in the high part and char in the low part
+        QHash<quint64, int> edges;
+
+        void add(const QString& term, int ruleIndex, bool ignoreCase);
+        void match(const QChar* text, int size, int pos, bool ignoreCase, QVector<Match>& matches) const;
+    };
+    Trie _exact;
+    Trie _caseless;
 };
 
 
@@ -48,6 +113,10 @@ struct Spec
 {
     Meta meta;
     QVector<Rule> rules;
+    TermMatcher terms;
+
+    // Unique for each loading of a spec, formats cached in blocks are only valid for the same version
+    int version = 0;
 
     // not empty only when spec is loaded withRawData
     // this stuff is required for highlighter editor
@@ -100,21 +169,91 @@ QMap<int, QString> loadSpecRaw(QSharedPointer<Spec> spec, const QString& source,
 QPair<bool, bool> checkDuplicates(const Meta& meta);
 QSyntaxHighlighter* createHighlighter(QPlainTextEdit* editor, const QString& name);
 
+// Formats found by rules in a block of text. Finding them doesn't touch the document,
+// so it can be done in any thread, only applying them requires the document's thread.
+struct BlockFormats
+{
+    struct Span
+    {
+        int rule;
+        int start;
+        int length;
+        QString href;
+    };
+
+    // Sorted and not overlapped, where matches of several rules overlap, the later rule wins
+    QVector<Span> spans;
+    // Multiline rule the block ends inside of, or -1
+    int state = -1;
+
+    static BlockFormats match(const Spec& spec, const QString& text, int previousState);
+
+private:
+    void resolveOverlaps(int textLength);
+};
+
+
 class Highlighter : public QSyntaxHighlighter
 {
     Q_OBJECT
 
 public:
     explicit Highlighter(QTextDocument *parent, const QSharedPointer<Spec>& spec);
+    ~Highlighter();
+
+    // Highlights deferred blocks in the range right away, e.g. when they are scrolled into view.
+    // The range is remembered as visible, its blocks are never deferred by following passes.
+    void highlightRange(int startPos, int stopPos);
+
+    // False if the block has not been highlighted yet, e.g. it waits for its time slice.
+    // Formats of such a block are missing, so its text can't be told from code or links.
+    bool isHighlighted(const QTextBlock& block) const;
+
+    // Keeps the visible part of the editor highlighted first: right away, on scrolling and resizing.
+    // `positionAt` returns the document position at a point of the editor's viewport.
+    void followViewport(QAbstractScrollArea* editor, const std::function<int(const QPoint&)>& positionAt);
 
 protected:
     void highlightBlock(const QString &text);
+    bool eventFilter(QObject* obj, QEvent* event) override;
 
 private:
     QSharedPointer<Spec> _spec;
     QTextDocument* _document;
 
-    int matchMultiline(const QString &text, const Rule& rule, int ruleIndex, int initialOffset);
+    // Large documents are highlighted in time slices. When highlighting of a document
+    // (or a large change in it) takes too long, the rest of blocks starting from
+    // _deferred are skipped and then highlighted by small portions in idle time.
+    QTextCursor _deferred;
+    QTextBlock _forced;
+    QElapsedTimer _passTime;
+    QTimer* _sliceTimer;
+    int _visibleStart = 0;
+    int _visibleStop = -1;
+    int _revision = 0;
+    QPointer<QWidget> _viewport;
+    std::function<int(const QPoint&)> _positionAt;
+
+    // When there are many deferred blocks, their formats are computed in parallel
+    // before slicing, then slices only apply them. Results are keyed by block number.
+    struct Precomputed
+    {
+        QString text;
+        int previousState;
+        BlockFormats formats;
+    };
+    QHash<int, Precomputed> _precomputed;
+    QFutureWatcher<QVector<Precomputed>>* _precomputing = nullptr;
+
+    bool deferBlock();
+    void documentChanged(int position, int charsRemoved, int charsAdded);
+    void startPrecompute();
+    void highlightSlice();
+    void highlightViewport();
+    QVector<QTextCharFormat> _ruleFormats;
+    int _ruleFormatsPointSize = -1;
+
+    const QVector<QTextCharFormat>& ruleFormats();
 };
 
 
@@ -139,6 +278,7 @@ private:
     QMenu* _menu;
     QActionGroup* _actionGroup = nullptr;
     QPointer<class ManagerDlg> _managerDlg;
+    bool _enabled = true;
 
     void actionGroupTriggered(QAction* action);
     void makeMenu();
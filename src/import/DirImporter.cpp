@@ -0,0 +1,179 @@
+#include "DirImporter.h"
+
+#include "../catalog/Catalog.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QtConcurrent>
+
+namespace {
+
+// Number of files that are read in parallel and then inserted in a single transaction
+const int BATCH_SIZE = 500;
+
+struct DirTask
+{
+    FolderItem* folder = nullptr;
+    QFileInfoList files;
+};
+
+struct FileReadResult
+{
+    MemoImportParam memo;
+    QString error;
+};
+
+FileReadResult readMemoFile(const QFileInfo& fileInfo)
+{
+    FileReadResult result;
+
+    QFile file(fileInfo.absoluteFilePath());
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        result.error = QString("Unable to read file %1: %2").arg(file.fileName(), file.errorString());
+        return result;
+    }
+
+    auto& memo = result.memo;
+    memo.title = fileInfo.completeBaseName();
+    memo.data = QString::fromUtf8(file.readAll());
+    if (memo.data.startsWith(QChar(0xFEFF)))
+        memo.data.remove(0, 1);
+
+    auto ext = fileInfo.suffix().toLower();
+    memo.type = (ext == QStringLiteral("md") || ext == QStringLiteral("markdown"))
+            ? markdownMemoType() : plainTextMemoType();
+
+    memo.updated = fileInfo.lastModified();
+    memo.created = fileInfo.birthTime();
+    if (!memo.created.isValid())
+        memo.created = memo.updated;
+
+    return result;
+}
+
+QString collectTasks(Catalog* catalog, FolderItem* parent, const QDir& dir, QVector<DirTask>& tasks, qint64& total)
+{
+    auto title = dir.dirName();
+    if (title.isEmpty())
+        title = QDir::toNativeSeparators(dir.absolutePath());
+
+    auto res = catalog->createFolder(parent, title);
+    if (!res.ok())
+        return res.error();
+
+    DirTask task;
+    task.folder = res.result();
+    task.files = dir.entryInfoList(DirImporter::fileNameFilters(), QDir::Files | QDir::Readable, QDir::Name);
+    total += task.files.size();
+    tasks << task;
+
+    for (const auto& subdir : dir.entryInfoList(QDir::Dirs | QDir::NoDotAndDotDot | QDir::Readable, QDir::Name))
+    {
+        auto err = collectTasks(catalog, task.folder, QDir(subdir.absoluteFilePath()), tasks, total);
+        if (!err.isEmpty()) return err;
+    }
+    return QString();
+}
+
+// Folders are made for the whole tree before importing, those left empty
+// by a canceled or failed import are removed, subfolders go first
+void removeEmptyFolders(Catalog* catalog, const QVector<DirTask>& tasks)
+{
+    for (int i = tasks.size() - 1; i >= 0; i--)
+    {
+        auto folder = tasks.at(i).folder;
+        if (!folder->children().isEmpty()) continue;
+
+        auto err = catalog->removeFolder(folder);
+        if (!err.isEmpty())
+            qWarning() << "DirImporter: unable to remove empty folder" << err;
+    }
+}
+
+} // namespace
+
+namespace DirImporter {
+
+QStringList fileNameFilters()
+{
+    return {
+        QStringLiteral("*.txt"),
+        QStringLiteral("*.text"),
+        QStringLiteral("*.md"),
+        QStringLiteral("*.markdown"),
+    };
+}
+
+ImportResult importDir(Catalog* catalog, FolderItem* target, const QString& dirPath, const ImportProgress& progress)
+{
+    ImportResult result;
+
+    QDir dir(dirPath);
+    if (!dir.exists())
+    {
+        result.error = QString("Directory does not exist: %1").arg(dirPath);
+        return result;
+    }
+
+    qint64 done = 0;
+    qint64 total = 0;
+    QVector<DirTask> tasks;
+    result.error = collectTasks(catalog, target, dir, tasks, total);
+    if (!result.error.isEmpty())
+    {
+        removeEmptyFolders(catalog, tasks);
+        return result;
+    }
+
+    if (progress && !progress(done, total))
+    {
+        removeEmptyFolders(catalog, tasks);
+        result.canceled = true;
+        return result;
+    }
+
+    for (const auto& task : tasks)
+    {
+        for (int start = 0; start < task.files.size(); start += BATCH_SIZE)
+        {
+            auto batch = task.files.mid(start, BATCH_SIZE);
+            auto reads = QtConcurrent::blockingMapped<QList<FileReadResult>>(batch, readMemoFile);
+
+            QVector<MemoImportParam> memos;
+            memos.reserve(reads.size());
+            for (const auto& read : reads)
+            {
+                if (!read.error.isEmpty())
+                {
+                    qWarning() << "DirImporter:" << read.error;
+                    result.warnings << read.error;
+                }
+                else memos << read.memo;
+            }
+
+            auto res = catalog->importMemos(task.folder, memos);
+            if (!res.ok())
+            {
+                removeEmptyFolders(catalog, tasks);
+                result.error = res.error();
+                return result;
+            }
+            result.imported += memos.size();
+
+            done += batch.size();
+            if (progress && !progress(done, total))
+            {
+                removeEmptyFolders(catalog, tasks);
+                result.canceled = true;
+                return result;
+            }
+        }
+    }
+
+    return result;
+}
+
+} // namespace DirImporter
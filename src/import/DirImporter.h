@@ -0,0 +1,21 @@
+#ifndef DIR_IMPORTER_H
+#define DIR_IMPORTER_H
+
+#include "Importer.h"
+
+class Catalog;
+class FolderItem;
+
+namespace DirImporter {
+
+QStringList fileNameFilters();
+
+// Imports text and markdown files from a directory. A new folder named after the directory
+// is created in the target folder (or at the top level when there is no target),
+// and subdirectories become its subfolders.
+ImportResult importDir(Catalog* catalog, FolderItem* target, const QString& dirPath,
+                       const ImportProgress& progress = ImportProgress());
+
+} // namespace DirImporter
+
+#endif // DIR_IMPORTER_H
@@ -0,0 +1,537 @@
+#include "EnexImporter.h"
+
+#include "../catalog/Catalog.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QTimeZone>
+#include <QXmlStreamReader>
+#include <QtConcurrent>
+
+namespace {
+
+// Number of notes that are converted in parallel and then inserted in a single transaction
+const int BATCH_SIZE = 200;
+
+struct EnexNote
+{
+    QString title;
+    QString content;
+    QDateTime created;
+    QDateTime updated;
+};
+
+QDateTime parseEnexDate(const QString& s)
+{
+    // Evernote uses the basic ISO 8601 format in UTC, e.g. 20191231T235959Z
+    auto date = QDate::fromString(s.left(8), QStringLiteral("yyyyMMdd"));
+    auto time = QTime::fromString(s.mid(9, 6), QStringLiteral("HHmmss"));
+    if (!date.isValid() || !time.isValid())
+        return QDateTime();
+    return QDateTime(date, time, QTimeZone::utc()).toLocalTime();
+}
+
+// ENML refers to the XHTML entities via its DTD, which is not loaded by the stream reader,
+// so such entities are reported unresolved and we have to resolve at least common ones
+QString resolveEntity(const QString& name)
+{
+    static const QHash<QString, QString> entities {
+        { QStringLiteral("nbsp"), QStringLiteral(" ") },
+        { QStringLiteral("quot"), QStringLiteral("\"") },
+        { QStringLiteral("apos"), QStringLiteral("'") },
+        { QStringLiteral("mdash"), QString(QChar(0x2014)) },
+        { QStringLiteral("ndash"), QString(QChar(0x2013)) },
+        { QStringLiteral("hellip"), QString(QChar(0x2026)) },
+        { QStringLiteral("laquo"), QString(QChar(0x00AB)) },
+        { QStringLiteral("raquo"), QString(QChar(0x00BB)) },
+        { QStringLiteral("lsquo"), QString(QChar(0x2018)) },
+        { QStringLiteral("rsquo"), QString(QChar(0x2019)) },
+        { QStringLiteral("ldquo"), QString(QChar(0x201C)) },
+        { QStringLiteral("rdquo"), QString(QChar(0x201D)) },
+        { QStringLiteral("bull"), QString(QChar(0x2022)) },
+        { QStringLiteral("middot"), QString(QChar(0x00B7)) },
+        { QStringLiteral("copy"), QString(QChar(0x00A9)) },
+        { QStringLiteral("reg"), QString(QChar(0x00AE)) },
+        { QStringLiteral("trade"), QString(QChar(0x2122)) },
+        { QStringLiteral("euro"), QString(QChar(0x20AC)) },
+    };
+    auto it = entities.constFind(name);
+    return it != entities.constEnd() ? it.value() : QStringLiteral("&%1;").arg(name);
+}
+
+//------------------------------------------------------------------------------
+//                                EnmlConverter
+//------------------------------------------------------------------------------
+
+// Converts a note content (ENML, a subset of XHTML) into markdown or plain text.
+// Only the structure is preserved: paragraphs, headers, lists, code blocks,
+// links and simple inline styles. Attachments are not imported.
+class EnmlConverter
+{
+public:
+    explicit EnmlConverter(bool markdown): _markdown(markdown) {}
+
+    QString convert(const QString& enml)
+    {
+        QXmlStreamReader xml(enml);
+        while (!xml.atEnd())
+        {
+            switch (xml.readNext())
+            {
+            case QXmlStreamReader::StartElement:
+                startElement(xml.name().toString(), xml.attributes());
+                break;
+            case QXmlStreamReader::EndElement:
+                endElement(xml.name().toString());
+                break;
+            case QXmlStreamReader::Characters:
+                text(xml.text().toString());
+                break;
+            case QXmlStreamReader::EntityReference:
+                text(resolveEntity(xml.name().toString()));
+                break;
+            default:
+                break;
+            }
+        }
+        if (xml.hasError())
+            qWarning() << "EnexImporter: invalid note content" << xml.errorString();
+        return _out.trimmed();
+    }
+
+private:
+    struct Link
+    {
+        QString href;
+        int start;
+    };
+
+    bool _markdown;
+    QString _out;
+    int _breaks = 0;
+    int _codeDepth = 0;
+    int _quoteDepth = 0;
+    int _cellIndex = 0;
+    QVector<int> _lists; // 0 for bulleted list, otherwise the number of the next item
+    QVector<bool> _blocks; // whether a div is a code block
+    QVector<Link> _links;
+
+    static bool isHeader(const QString& tag)
+    {
+        return tag.size() == 2 && tag[0] == 'h' && tag[1] >= '1' && tag[1] <= '6';
+    }
+
+    void startElement(const QString& tag, const QXmlStreamAttributes& attrs)
+    {
+        if (tag == QLatin1String("div") || tag == QLatin1String("p"))
+        {
+            // Evernote stores code blocks as divs with a special style
+            bool isCode = attrs.value(QLatin1String("style")).contains(QLatin1String("-en-codeblock:true"));
+            _blocks << isCode;
+            if (isCode)
+                startCode();
+            else
+                lineBreak(tag == QLatin1String("p") ? 2 : 1);
+        }
+        else if (isHeader(tag))
+        {
+            lineBreak(2);
+            if (_markdown)
+                write(QString(tag[1].digitValue(), '#') + ' ');
+        }
+        else if (tag == QLatin1String("br"))
+        {
+            if (!_out.isEmpty()) _breaks++;
+        }
+        else if (tag == QLatin1String("hr"))
+        {
+            lineBreak(2);
+            write(_markdown ? QStringLiteral("---") : QString(10, '-'));
+            lineBreak(2);
+        }
+        else if (tag == QLatin1String("b") || tag == QLatin1String("strong"))
+            markup(QStringLiteral("**"));
+        else if (tag == QLatin1String("i") || tag == QLatin1String("em"))
+            markup(QStringLiteral("*"));
+        else if (tag == QLatin1String("s") || tag == QLatin1String("strike") || tag == QLatin1String("del"))
+            markup(QStringLiteral("~~"));
+        else if (tag == QLatin1String("code"))
+        {
+            if (_codeDepth == 0) markup(QStringLiteral("`"));
+        }
+        else if (tag == QLatin1String("pre"))
+            startCode();
+        else if (tag == QLatin1String("a"))
+        {
+            markup(QStringLiteral("["));
+            flushBreaks();
+            _links << Link{attrs.value(QLatin1String("href")).toString(), int(_out.size())};
+        }
+        else if (tag == QLatin1String("ul") || tag == QLatin1String("ol"))
+        {
+            _lists << (tag == QLatin1String("ol") ? 1 : 0);
+            lineBreak(1);
+        }
+        else if (tag == QLatin1String("li"))
+        {
+            lineBreak(1);
+            QString marker = QStringLiteral("- ");
+            int level = 0;
+            if (!_lists.isEmpty())
+            {
+                int& counter = _lists.last();
+                if (counter > 0)
+                    marker = QStringLiteral("%1. ").arg(counter++);
+                level = _lists.size() - 1;
+            }
+            write(QString(level * 4, ' ') + marker);
+        }
+        else if (tag == QLatin1String("en-todo"))
+        {
+            bool checked = attrs.value(QLatin1String("checked")) == QLatin1String("true");
+            write(checked ? QStringLiteral("[x] ") : QStringLiteral("[ ] "));
+        }
+        else if (tag == QLatin1String("en-media"))
+            write(QStringLiteral("[attachment]"));
+        else if (tag == QLatin1String("blockquote"))
+        {
+            lineBreak(2);
+            _quoteDepth++;
+        }
+        else if (tag == QLatin1String("table"))
+            lineBreak(2);
+        else if (tag == QLatin1String("tr"))
+        {
+            lineBreak(1);
+            _cellIndex = 0;
+        }
+        else if (tag == QLatin1String("td") || tag == QLatin1String("th"))
+        {
+            if (_cellIndex++ > 0)
+                write(QStringLiteral(" | "));
+        }
+    }
+
+    void endElement(const QString& tag)
+    {
+        if (tag == QLatin1String("div") || tag == QLatin1String("p"))
+        {
+            bool isCode = !_blocks.isEmpty() && _blocks.takeLast();
+            if (isCode)
+                endCode();
+            else
+                lineBreak(tag == QLatin1String("p") ? 2 : 1);
+        }
+        else if (isHeader(tag))
+            lineBreak(2);
+        else if (tag == QLatin1String("b") || tag == QLatin1String("strong"))
+            markup(QStringLiteral("**"));
+        else if (tag == QLatin1String("i") || tag == QLatin1String("em"))
+            markup(QStringLiteral("*"));
+        else if (tag == QLatin1String("s") || tag == QLatin1String("strike") || tag == QLatin1String("del"))
+            markup(QStringLiteral("~~"));
+        else if (tag == QLatin1String("code"))
+        {
+            if (_codeDepth == 0) markup(QStringLiteral("`"));
+        }
+        else if (tag == QLatin1String("pre"))
+            endCode();
+        else if (tag == QLatin1String("a"))
+        {
+            if (_links.isEmpty()) return;
+            auto link = _links.takeLast();
+            if (_markdown)
+                write(link.href.isEmpty() ? QStringLiteral("]") : QStringLiteral("](%1)").arg(link.href));
+            else if (!link.href.isEmpty() && _out.mid(link.start) != link.href)
+                write(QStringLiteral(" (%1)").arg(link.href));
+        }
+        else if (tag == QLatin1String("ul") || tag == QLatin1String("ol"))
+        {
+            if (!_lists.isEmpty()) _lists.removeLast();
+            lineBreak(1);
+        }
+        else if (tag == QLatin1String("li"))
+            lineBreak(1);
+        else if (tag == QLatin1String("blockquote"))
+        {
+            if (_quoteDepth > 0) _quoteDepth--;
+            lineBreak(2);
+        }
+        else if (tag == QLatin1String("table"))
+            lineBreak(2);
+    }
+
+    void text(const QString& s)
+    {
+        if (_codeDepth > 0)
+        {
+            if (!s.isEmpty()) write(s);
+            return;
+        }
+
+        // Collapse whitespaces as html renderer does
+        QString t;
+        t.reserve(s.size());
+        bool space = false;
+        for (const QChar& c : s)
+        {
+            if (c.isSpace())
+            {
+                space = true;
+                continue;
+            }
+            if (space && (!t.isEmpty() || !atSpace()))
+                t += ' ';
+            space = false;
+            t += c;
+        }
+        if (space && (!t.isEmpty() || !atSpace()))
+            t += ' ';
+        if (!t.isEmpty())
+            write(t);
+    }
+
+    void startCode()
+    {
+        lineBreak(1);
+        if (_markdown && _codeDepth == 0)
+        {
+            write(QStringLiteral("```"));
+            lineBreak(1);
+        }
+        _codeDepth++;
+    }
+
+    void endCode()
+    {
+        if (_codeDepth > 0) _codeDepth--;
+        lineBreak(1);
+        if (_markdown && _codeDepth == 0)
+        {
+            write(QStringLiteral("```"));
+            lineBreak(1);
+        }
+    }
+
+    void markup(const QString& s)
+    {
+        if (_markdown) write(s);
+    }
+
+    void write(const QString& s)
+    {
+        flushBreaks();
+        _out += s;
+    }
+
+    bool atSpace() const
+    {
+        return _breaks > 0 || _out.isEmpty() || _out.endsWith('\n') || _out.endsWith(' ');
+    }
+
+    void lineBreak(int count)
+    {
+        if (!_out.isEmpty() && _breaks < count)
+            _breaks = count;
+    }
+
+    void flushBreaks()
+    {
+        if (_breaks == 0) return;
+        if (_codeDepth == 0)
+            while (_out.endsWith(' '))
+                _out.chop(1);
+        _out += QString(_breaks, '\n');
+        _breaks = 0;
+        if (_markdown && _quoteDepth > 0)
+            _out += QStringLiteral("> ").repeated(_quoteDepth);
+    }
+};
+
+MemoImportParam convertNote(const EnexNote& note, bool markdown)
+{
+    MemoImportParam memo;
+    memo.title = note.title.trimmed();
+    if (memo.title.isEmpty())
+        memo.title = QStringLiteral("Untitled");
+    memo.data = EnmlConverter(markdown).convert(note.content);
+    memo.type = markdown ? markdownMemoType() : plainTextMemoType();
+    memo.created = note.created;
+    memo.updated = note.updated.isValid() ? note.updated : note.created;
+    return memo;
+}
+
+MemoImportParam convertNoteToMarkdown(const EnexNote& note)
+{
+    return convertNote(note, true);
+}
+
+MemoImportParam convertNoteToPlainText(const EnexNote& note)
+{
+    return convertNote(note, false);
+}
+
+EnexNote readNote(QXmlStreamReader& xml)
+{
+    EnexNote note;
+    while (xml.readNextStartElement())
+    {
+        if (xml.name() == QLatin1String("title"))
+            note.title = xml.readElementText();
+        else if (xml.name() == QLatin1String("content"))
+            note.content = xml.readElementText();
+        else if (xml.name() == QLatin1String("created"))
+            note.created = parseEnexDate(xml.readElementText());
+        else if (xml.name() == QLatin1String("updated"))
+            note.updated = parseEnexDate(xml.readElementText());
+        else
+            // Resources are skipped as a stream too, without keeping their data
+            xml.skipCurrentElement();
+    }
+    return note;
+}
+
+//------------------------------------------------------------------------------
+//                                 NotesWriter
+//------------------------------------------------------------------------------
+
+// Converts a batch of notes in background threads while the next batch is being parsed,
+// then writes the converted memos into the catalog in a single transaction.
+class NotesWriter
+{
+public:
+    NotesWriter(Catalog* catalog, FolderItem* folder, MemoType* memoType, ImportResult& result)
+        : _catalog(catalog), _folder(folder), _memoType(memoType), _result(result) {}
+
+    bool write(const QVector<EnexNote>& notes)
+    {
+        if (!finish()) return false;
+        _converting = QtConcurrent::mapped(notes, _memoType == markdownMemoType()
+            ? convertNoteToMarkdown : convertNoteToPlainText);
+        _hasPending = true;
+        return true;
+    }
+
+    bool finish()
+    {
+        if (!_hasPending) return true;
+        _hasPending = false;
+
+        _converting.waitForFinished();
+        auto converted = _converting.results();
+        QVector<MemoImportParam> memos(converted.begin(), converted.end());
+
+        auto res = _catalog->importMemos(_folder, memos);
+        if (!res.ok())
+        {
+            _result.error = res.error();
+            return false;
+        }
+        _result.imported += memos.size();
+        return true;
+    }
+
+    void cancel()
+    {
+        if (!_hasPending) return;
+        _hasPending = false;
+        _converting.cancel();
+        _converting.waitForFinished();
+    }
+
+private:
+    Catalog* _catalog;
+    FolderItem* _folder;
+    MemoType* _memoType;
+    ImportResult& _result;
+    QFuture<MemoImportParam> _converting;
+    bool _hasPending = false;
+};
+
+} // namespace
+
+namespace EnexImporter {
+
+QString fileFilter()
+{
+    return qApp->tr("Evernote Export Files (*.enex);;All files (*.*)");
+}
+
+ImportResult importFile(Catalog* catalog, FolderItem* target, const QString& fileName,
+                        MemoType* memoType, const ImportProgress& progress)
+{
+    ImportResult result;
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        result.error = QString("Unable to open file %1: %2").arg(fileName, file.errorString());
+        return result;
+    }
+
+    QXmlStreamReader xml(&file);
+    if (!xml.readNextStartElement() || xml.name() != QLatin1String("en-export"))
+    {
+        result.error = QString("File %1 is not an Evernote export file").arg(fileName);
+        return result;
+    }
+
+    auto folder = catalog->createFolder(target, QFileInfo(fileName).completeBaseName());
+    if (!folder.ok())
+    {
+        result.error = folder.error();
+        return result;
+    }
+
+    NotesWriter writer(catalog, folder.result(), memoType, result);
+
+    QVector<EnexNote> notes;
+    notes.reserve(BATCH_SIZE);
+    while (xml.readNextStartElement())
+    {
+        if (xml.name() != QLatin1String("note"))
+        {
+            xml.skipCurrentElement();
+            continue;
+        }
+
+        notes << readNote(xml);
+        if (notes.size() < BATCH_SIZE)
+            continue;
+
+        if (!writer.write(notes))
+            return result;
+        notes.clear();
+
+        if (progress && !progress(file.pos(), file.size()))
+        {
+            writer.cancel();
+            result.canceled = true;
+            return result;
+        }
+    }
+
+    if (xml.hasError())
+    {
+        auto err = QString("Failed to parse %1 at line %2: %3")
+                .arg(fileName).arg(xml.lineNumber()).arg(xml.errorString());
+        qWarning() << "EnexImporter:" << err;
+        result.warnings << err;
+    }
+
+    if (!notes.isEmpty() && !writer.write(notes))
+        return result;
+
+    if (!writer.finish())
+        return result;
+
+    if (progress)
+        progress(file.size(), file.size());
+
+    return result;
+}
+
+} // namespace EnexImporter
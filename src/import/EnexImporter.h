@@ -0,0 +1,24 @@
+#ifndef ENEX_IMPORTER_H
+#define ENEX_IMPORTER_H
+
+#include "Importer.h"
+
+class Catalog;
+class FolderItem;
+class MemoType;
+
+namespace EnexImporter {
+
+QString fileFilter();
+
+// Imports notes from Evernote export file (*.enex). A new folder named after the file
+// is created in the target folder (or at the top level when there is no target).
+// The file is parsed as a stream, so only a couple of note batches are kept in memory
+// at a time regardless of the export size. Notes are converted from ENML into memos
+// of the given type (markdown or plain text) in background threads.
+ImportResult importFile(Catalog* catalog, FolderItem* target, const QString& fileName,
+                        MemoType* memoType, const ImportProgress& progress = ImportProgress());
+
+} // namespace EnexImporter
+
+#endif // ENEX_IMPORTER_H
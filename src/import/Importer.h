@@ -0,0 +1,21 @@
+#ifndef IMPORTER_H
+#define IMPORTER_H
+
+#include <QString>
+#include <QStringList>
+
+#include <functional>
+
+struct ImportResult
+{
+    QString error;
+    QStringList warnings;
+    int imported = 0;
+    bool canceled = false;
+};
+
+// Importers call it from time to time with the amount of already processed work.
+// Returning false cancels importing, memos that are already imported are kept.
+typedef std::function<bool(qint64 done, qint64 total)> ImportProgress;
+
+#endif // IMPORTER_H
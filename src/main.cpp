@@ -2,7 +2,9 @@
 
 #include "AppSettings.h"
 #include "AppTheme.h"
+#include "StartupTrace.h"
 #include "Utils.h"
+#include "cli/Cli.h"
 
 #include "tools/OriDebug.h"
 #include "tools/OriSettings.h"
@@ -16,6 +18,7 @@
 bool processCommandLine()
 {
     QCommandLineParser parser;
+    parser.setApplicationDescription(Cli::commandsHelp());
     auto optionHelp = parser.addHelpOption();
     auto optionVersion = parser.addVersionOption();
     QCommandLineOption optionDevMode("dev"); optionDevMode.setFlags(QCommandLineOption::HiddenFromHelp);
@@ -50,25 +53,36 @@ bool processCommandLine()
 
 int main(int argc, char *argv[])
 {
+    // Scripting commands don't need GUI so check them before anything else
+    if (Cli::isCommand(argc, argv))
+        return Cli::run(argc, argv);
+
+    StartupTrace::mark("Process started");
+
     QApplication app(argc, argv);
     app.setApplicationName("Procyon");
     app.setOrganizationName("orion-project.org");
     app.setApplicationVersion(APP_VER);
     app.setStyle(QStyleFactory::create("Fusion"));
 
+    StartupTrace::mark("Application created");
+
     if (!processCommandLine()) return 1;
 
     // Load settings
     auto s1 = Ori::Settings::open();
     AppSettings::instance().load(s1);
+    StartupTrace::mark("Settings loaded");
 
     // Call `setStyleSheet` after setting loaded
     // to be able to apply custom colors.
     app.setStyleSheet(AppTheme::makeStyleSheet(AppTheme::loadRawStyleSheet()));
+    StartupTrace::mark("Style sheet applied");
 
     MainWindow  w;
     w.loadSettings(s1);
     delete s1;
+    StartupTrace::mark("Main window created");
 
     w.show();
     int res = app.exec();
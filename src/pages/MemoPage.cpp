@@ -228,6 +228,11 @@ QString MemoPage::spellcheckLang() const
     return _memoEditor->spellcheckLang();
 }
 
+void MemoPage::dropSpellcheckResults()
+{
+    _memoEditor->setSpellcheckCacheKey(QString());
+}
+
 void MemoPage::setHighlighter(const QString& name)
 {
     auto editor = dynamic_cast<TextMemoEditor*>(_memoEditor);
@@ -268,6 +273,11 @@ void MemoPage::loadSettings()
     _memoEditor->setWordWrap(options.contains(MemoOptions::WORD_WRAP)
         ? options[MemoOptions::WORD_WRAP].toBool() : AppSettings::instance().memoWordWrap);
 
+    // Memo ids are only unique inside a catalog, nothing is cached until the catalog gets its uid
+    auto catalogUid = _catalog->uid();
+    if (!catalogUid.isEmpty())
+        _memoEditor->setSpellcheckCacheKey(catalogUid + '/' + QString::number(_memoItem->id()));
+
     if (options.contains(MemoOptions::SPELLCHECK))
         _memoEditor->setSpellcheckLang(options[MemoOptions::SPELLCHECK].toString());
 
@@ -35,6 +35,8 @@ public:
 
     void setSpellcheckLang(const QString& lang);
     QString spellcheckLang() const;
+    // Spellcheck results are not saved when the page is closed, e.g. when the memo is deleted
+    void dropSpellcheckResults();
 
     void setHighlighter(const QString& name);
     QString highlighter() const;
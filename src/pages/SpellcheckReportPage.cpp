@@ -0,0 +1,92 @@
+#include "SpellcheckReportPage.h"
+
+#ifdef ENABLE_SPELLCHECK
+
+#include "PageWidgets.h"
+#include "../catalog/Catalog.h"
+#include "../spellcheck/SpellcheckReport.h"
+#include "helpers/OriLayouts.h"
+
+#include <QHeaderView>
+#include <QLabel>
+#include <QToolBar>
+#include <QTreeWidget>
+
+#include <algorithm>
+
+namespace {
+
+enum ReportColumns { COL_TEXT, COL_COUNT };
+
+} // namespace
+
+SpellcheckReportPage::SpellcheckReportPage(Catalog* catalog, const QString& title, const SpellcheckReportResult& result)
+    : QWidget(), _catalog(catalog)
+{
+    setWindowTitle(title);
+    setWindowIcon(QIcon(":/icon/main"));
+
+    auto tree = new QTreeWidget;
+    tree->setProperty("role", "memo_editor");
+    tree->setHeaderLabels({tr("Memo / Word"), tr("Count")});
+    tree->header()->setSectionResizeMode(COL_TEXT, QHeaderView::Stretch);
+    tree->header()->setSectionResizeMode(COL_COUNT, QHeaderView::ResizeToContents);
+    tree->header()->setStretchLastSection(false);
+    connect(tree, &QTreeWidget::itemActivated, this, &SpellcheckReportPage::itemActivated);
+
+    int totalWords = 0;
+    for (const auto& memo : result.memos)
+    {
+        auto memoItem = catalog->findMemoById(memo.memoId);
+        if (!memoItem) continue;
+
+        // The most frequent misspellings are likely to be real words missing in the dictionary
+        QVector<QPair<int, QString>> words;
+        int memoWords = 0;
+        for (auto it = memo.words.constBegin(); it != memo.words.constEnd(); it++)
+        {
+            words << qMakePair(it.value(), it.key());
+            memoWords += it.value();
+        }
+        std::sort(words.begin(), words.end(), [](const QPair<int, QString>& a, const QPair<int, QString>& b){
+            return a.first > b.first || (a.first == b.first && a.second < b.second);
+        });
+        totalWords += memoWords;
+
+        auto item = new QTreeWidgetItem(tree, {memoItem->displayPath(), QString::number(memoWords)});
+        item->setIcon(COL_TEXT, memoItem->type()->icon());
+        item->setData(COL_TEXT, Qt::UserRole, memo.memoId);
+        item->setToolTip(COL_TEXT, memo.lang);
+        for (const auto& word : words)
+        {
+            auto wordItem = new QTreeWidgetItem(item, {word.second, QString::number(word.first)});
+            wordItem->setData(COL_TEXT, Qt::UserRole, memo.memoId);
+        }
+    }
+
+    QString summary = tr("Checked memos: %1, memos with misspellings: %2, misspelled words: %3")
+            .arg(result.checked).arg(result.memos.size()).arg(totalWords);
+    if (result.canceled)
+        summary += ' ' + tr("(canceled)");
+    auto summaryLabel = new QLabel(summary);
+    summaryLabel->setContentsMargins(6, 3, 6, 3);
+
+    auto titleEditor = PageWidgets::makeTitleEditor(windowTitle());
+
+    auto toolbar = new QToolBar;
+    toolbar->addAction(QIcon(":/toolbar/close"), tr("Close"), [this](){
+        deleteLater();
+    });
+
+    auto toolPanel = PageWidgets::makeHeaderPanel({titleEditor, toolbar});
+
+    Ori::Layouts::LayoutV({toolPanel, summaryLabel, tree}).setMargin(0).setSpacing(0).useFor(this);
+}
+
+void SpellcheckReportPage::itemActivated(QTreeWidgetItem* item)
+{
+    auto memo = _catalog->findMemoById(item->data(COL_TEXT, Qt::UserRole).toInt());
+    if (memo) emit openMemo(memo);
+}
+
+#endif // ENABLE_SPELLCHECK
@@ -0,0 +1,34 @@
+#ifndef SPELLCHECK_REPORT_PAGE_H
+#define SPELLCHECK_REPORT_PAGE_H
+
+#ifdef ENABLE_SPELLCHECK
+
+#include <QWidget>
+
+class Catalog;
+class MemoItem;
+struct SpellcheckReportResult;
+
+QT_BEGIN_NAMESPACE
+class QTreeWidgetItem;
+QT_END_NAMESPACE
+
+class SpellcheckReportPage : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit SpellcheckReportPage(Catalog* catalog, const QString& title, const SpellcheckReportResult& result);
+
+signals:
+    void openMemo(MemoItem* item);
+
+private:
+    Catalog* _catalog;
+
+    void itemActivated(QTreeWidgetItem* item);
+};
+
+#endif // ENABLE_SPELLCHECK
+
+#endif // SPELLCHECK_REPORT_PAGE_H
@@ -0,0 +1,146 @@
+#include "SpellcheckCache.h"
+
+#ifdef ENABLE_SPELLCHECK
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDebug>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+namespace {
+
+const quint32 fileMagic = 0x53504C43; // SPLC
+// Should be increased when tokenizing or skipping rules change, it invalidates all results
+const quint32 fileVersion = 1;
+
+QString cacheDir()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/spellcheck";
+}
+
+// Files of memos not edited for so long are deleted, as well as the oldest files
+// when all of them take too much space. Results of deleted memos and catalogs
+// can't be told from others by file name, so they are dropped this way too.
+const int maxAgeDays = 90;
+const qint64 maxTotalSize = 50 * 1024 * 1024;
+
+// Memo keys contain catalog uids, they are not good as file names
+QString cacheFilePath(const QString& memoKey)
+{
+    auto hash = QCryptographicHash::hash(memoKey.toUtf8(), QCryptographicHash::Md5).toHex();
+    return cacheDir() + '/' + QString::fromLatin1(hash) + ".marks";
+}
+
+// It's done once per session, when results are saved for the first time
+void pruneOnce()
+{
+    static bool pruned = false;
+    if (pruned) return;
+    pruned = true;
+
+    auto files = QDir(cacheDir()).entryInfoList({"*.marks"}, QDir::Files, QDir::Time);
+    auto oldest = QDateTime::currentDateTime().addDays(-maxAgeDays);
+    qint64 totalSize = 0;
+    // Files are sorted by modification time, newest first
+    for (const auto& file : files)
+    {
+        totalSize += file.size();
+        if (file.lastModified() < oldest || totalSize > maxTotalSize)
+            QFile::remove(file.absoluteFilePath());
+    }
+}
+
+} // namespace
+
+SpellcheckCache SpellcheckCache::load(const QString& memoKey, const QString& dictVersion)
+{
+    SpellcheckCache cache;
+
+    QFile file(cacheFilePath(memoKey));
+    if (!file.open(QIODevice::ReadOnly)) return cache;
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+
+    quint32 magic, version;
+    stream >> magic >> version;
+    if (magic != fileMagic || version != fileVersion) return cache;
+
+    QString fileDictVersion;
+    stream >> fileDictVersion;
+    if (fileDictVersion != dictVersion) return cache;
+
+    stream >> cache._ignored;
+
+    quint32 count;
+    stream >> count;
+    for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; i++)
+    {
+        quint64 hash;
+        quint32 errorCount;
+        stream >> hash >> errorCount;
+        Errors errors;
+        errors.reserve(errorCount);
+        for (quint32 j = 0; j < errorCount && stream.status() == QDataStream::Ok; j++)
+        {
+            qint32 start, length;
+            stream >> start >> length;
+            errors << Error {start, length};
+        }
+        cache._blocks.insert(hash, errors);
+    }
+
+    if (stream.status() != QDataStream::Ok)
+    {
+        qWarning() << "Unable to read spellcheck cache" << file.fileName();
+        return SpellcheckCache();
+    }
+    return cache;
+}
+
+bool SpellcheckCache::save(const QString& memoKey, const QString& dictVersion) const
+{
+    if (!QDir().mkpath(cacheDir())) return false;
+    pruneOnce();
+
+    QSaveFile file(cacheFilePath(memoKey));
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        qWarning() << "Unable to open file for writing" << file.fileName() << file.errorString();
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+    stream << fileMagic << fileVersion << dictVersion << _ignored << quint32(_blocks.size());
+    for (auto it = _blocks.constBegin(); it != _blocks.constEnd(); it++)
+    {
+        stream << it.key() << quint32(it.value().size());
+        for (const auto& error : it.value())
+            stream << qint32(error.start) << qint32(error.length);
+    }
+
+    if (!file.commit())
+    {
+        qWarning() << "Unable to write spellcheck cache" << file.fileName() << file.errorString();
+        return false;
+    }
+    return true;
+}
+
+void SpellcheckCache::remove(const QString& memoKey)
+{
+    QFile::remove(cacheFilePath(memoKey));
+}
+
+const SpellcheckCache::Errors* SpellcheckCache::find(quint64 blockHash) const
+{
+    auto it = _blocks.constFind(blockHash);
+    return it == _blocks.constEnd() ? nullptr : &it.value();
+}
+
+#endif // ENABLE_SPELLCHECK
@@ -0,0 +1,48 @@
+#ifndef SPELLCHECK_CACHE_H
+#define SPELLCHECK_CACHE_H
+
+#ifdef ENABLE_SPELLCHECK
+
+#include <QHash>
+#include <QStringList>
+#include <QVector>
+
+// Spellcheck results of a memo saved between sessions, so error marks can be shown
+// as soon as the memo is opened for editing, and only text changed since then is checked.
+//
+// Results are stored per text block and keyed by a hash of the block content,
+// so they are found wherever the block is now. The whole file is dropped when it
+// was made with another dictionary or with words ignored which are not ignored anymore.
+class SpellcheckCache
+{
+public:
+    struct Error
+    {
+        int start;
+        int length;
+    };
+    using Errors = QVector<Error>;
+
+    // Returns empty cache if there is no file or it was made for another dictionary version.
+    static SpellcheckCache load(const QString& memoKey, const QString& dictVersion);
+    bool save(const QString& memoKey, const QString& dictVersion) const;
+
+    // Deletes results of the memo, e.g. when the memo itself is deleted.
+    static void remove(const QString& memoKey);
+
+    // Words ignored at the moment of saving, the cache is only valid if they are still ignored.
+    const QStringList& ignoredWords() const { return _ignored; }
+    void setIgnoredWords(const QStringList& words) { _ignored = words; }
+
+    bool isEmpty() const { return _blocks.isEmpty(); }
+    const Errors* find(quint64 blockHash) const;
+    void insert(quint64 blockHash, const Errors& errors) { _blocks.insert(blockHash, errors); }
+
+private:
+    QStringList _ignored;
+    QHash<quint64, Errors> _blocks;
+};
+
+#endif // ENABLE_SPELLCHECK
+
+#endif // SPELLCHECK_CACHE_H
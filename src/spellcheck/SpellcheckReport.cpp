@@ -0,0 +1,166 @@
+#include "SpellcheckReport.h"
+
+#ifdef ENABLE_SPELLCHECK
+
+#include "Spellchecker.h"
+#include "../TextTokenizer.h"
+#include "../catalog/CatalogStore.h"
+#include "../highlighter/OriHighlighter.h"
+
+#include <QAtomicInteger>
+#include <QHash>
+#include <QMutex>
+#include <QThread>
+#include <QThreadPool>
+
+namespace {
+
+// Memo texts read ahead of checking are limited, the whole catalog should not get into memory
+const qint64 maxPendingChars = 16 * 1024 * 1024;
+
+void checkText(ThreadSpellchecker* checker, QStringView text, QMap<QString, int>& misspellings)
+{
+    TextTokenizer words(text);
+    while (words.next())
+    {
+        // Skip one-letter words and abbreviations like e.g.
+        if (words.length() < 2 || words.isAbbreviation())
+            continue;
+
+        auto word = words.word().toString();
+        if (!checker->check(word))
+            misspellings[word]++;
+    }
+}
+
+// It's run in a worker thread. Text is skipped the same way as in the editor:
+// hyperlinks and no-spell spans (code, commands) found by the memo's highlighter are not checked.
+QMap<QString, int> findMisspellings(const ThreadSpellchecker::Files& files,
+                                    const QSharedPointer<Ori::Highlighter::Spec>& spec, const QString& text)
+{
+    QMap<QString, int> misspellings;
+
+    auto checker = ThreadSpellchecker::get(files);
+    if (!checker) return misspellings;
+
+    if (!spec)
+    {
+        checkText(checker, text, misspellings);
+        return misspellings;
+    }
+
+    // Lines are matched as document blocks, multiline rules are continued via the state
+    int state = -1;
+    for (auto line : QStringView(text).split('\n'))
+    {
+        auto lineText = line.toString();
+        auto formats = Ori::Highlighter::BlockFormats::match(*spec, lineText, state);
+        state = formats.state;
+
+        int pos = 0;
+        for (const auto& span : formats.spans)
+        {
+            const auto& rule = spec->rules.at(span.rule);
+            if (!rule.noSpell && (!rule.hyperlink || span.href.isEmpty()))
+                continue;
+            if (span.start > pos)
+                checkText(checker, line.sliced(pos, span.start - pos), misspellings);
+            pos = qMax(pos, span.start + span.length);
+        }
+        if (pos < line.size())
+            checkText(checker, line.sliced(pos), misspellings);
+    }
+    return misspellings;
+}
+
+} // namespace
+
+namespace SpellcheckReport {
+
+SpellcheckReportResult checkMemos(const QVector<int>& memoIds, const SpellcheckProgress& progress)
+{
+    SpellcheckReportResult result;
+
+    auto langs = CatalogStore::memoManager()->selectOptionValues("spellcheck");
+    auto highlighters = CatalogStore::memoManager()->selectOptionValues("highlighter");
+
+    // Specs are loaded here as their cache is not thread safe, workers only match them
+    QMap<QString, QSharedPointer<Ori::Highlighter::Spec>> specs;
+
+    QMap<QString, ThreadSpellchecker::Files> files;
+    QVector<int> ids;
+    for (int id : memoIds)
+    {
+        auto lang = langs.value(id).toString();
+        if (lang.isEmpty()) continue;
+        if (!files.contains(lang))
+            files.insert(lang, ThreadSpellchecker::files(lang));
+        if (!files[lang].isValid()) continue;
+        ids << id;
+
+        auto highlighter = highlighters.value(id).toString();
+        if (!highlighter.isEmpty() && !specs.contains(highlighter))
+            specs.insert(highlighter, Ori::Highlighter::getSpec(highlighter));
+    }
+    if (ids.isEmpty()) return result;
+
+    // Each thread of the pool loads its own dictionaries, they are freed when the pool is deleted
+    QThreadPool pool;
+    QMutex mutex;
+    QHash<int, QMap<QString, int>> found;
+    QAtomicInteger<qint64> pendingChars(0);
+    QAtomicInt done(0);
+    const int total = ids.size();
+    bool canceled = false;
+
+    auto res = CatalogStore::memoManager()->enumerateData([&](int memoId, const QString& data){
+        auto langFiles = files[langs[memoId].toString()];
+        auto spec = specs.value(highlighters.value(memoId).toString());
+        pendingChars.fetchAndAddOrdered(data.size());
+        pool.start([&, memoId, data, langFiles, spec]{
+            auto words = findMisspellings(langFiles, spec, data);
+            if (!words.isEmpty())
+            {
+                QMutexLocker lock(&mutex);
+                found.insert(memoId, words);
+            }
+            pendingChars.fetchAndAddOrdered(-data.size());
+            done.fetchAndAddOrdered(1);
+        });
+
+        // Reading is much faster than checking, so wait for workers to catch up
+        while (pendingChars.loadAcquire() > maxPendingChars)
+        {
+            if (!progress(done.loadAcquire(), total))
+            {
+                canceled = true;
+                return false;
+            }
+            QThread::msleep(10);
+        }
+        canceled = !progress(done.loadAcquire(), total);
+        return !canceled;
+    }, ids);
+
+    if (!res.isEmpty() || canceled)
+        pool.clear();
+
+    while (!pool.waitForDone(50))
+        if (!canceled && !progress(done.loadAcquire(), total))
+        {
+            canceled = true;
+            pool.clear();
+        }
+
+    result.error = res;
+    result.canceled = canceled;
+    result.checked = done.loadAcquire();
+    for (int id : ids)
+        if (found.contains(id))
+            result.memos << MemoMisspellings {id, langs[id].toString(), found[id]};
+    return result;
+}
+
+} // namespace SpellcheckReport
+
+#endif // ENABLE_SPELLCHECK
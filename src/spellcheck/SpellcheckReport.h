@@ -0,0 +1,42 @@
+#ifndef SPELLCHECK_REPORT_H
+#define SPELLCHECK_REPORT_H
+
+#ifdef ENABLE_SPELLCHECK
+
+#include <QMap>
+#include <QString>
+#include <QVector>
+
+#include <functional>
+
+struct MemoMisspellings
+{
+    int memoId;
+    QString lang;
+    QMap<QString, int> words; // Misspelled word -> number of its occurrences in the memo
+};
+
+struct SpellcheckReportResult
+{
+    QString error;
+    QVector<MemoMisspellings> memos;
+    int checked = 0;
+    bool canceled = false;
+};
+
+// It's called from time to time with the number of already checked memos.
+// Returning false cancels checking, results for already checked memos are kept.
+typedef std::function<bool(int done, int total)> SpellcheckProgress;
+
+namespace SpellcheckReport {
+
+// Checks memos in their stored spellcheck languages, memos without spellcheck are skipped.
+// Memo texts are read from the database in the calling thread and checked across all cores.
+// Links and code found by the memo's highlighter are not checked, the same as in the editor.
+SpellcheckReportResult checkMemos(const QVector<int>& memoIds, const SpellcheckProgress& progress);
+
+} // namespace SpellcheckReport
+
+#endif // ENABLE_SPELLCHECK
+
+#endif // SPELLCHECK_REPORT_H
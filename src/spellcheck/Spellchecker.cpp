@@ -2,6 +2,8 @@
 
 #ifdef ENABLE_SPELLCHECK
 
+#include "SuggestIndex.h"
+#include "../AppSettings.h"
 #include "hunspell/hunspell.hxx"
 
 #include <QActionGroup>
@@ -10,12 +12,22 @@
 #include <QDir>
 #include <QFile>
 #include <QFileInfo>
+#include <QFutureWatcher>
 #include <QMenu>
+#include <QPromise>
 #include <QRegularExpression>
+#include <QSaveFile>
+#include <QSet>
+#include <QStandardPaths>
 #include <QTextCodec>
+#include <QThreadPool>
+#include <QTimer>
+#include <QtConcurrent>
 
 #include "tools/OriSettings.h"
 
+#include <algorithm>
+
 QMap<QString, QString> langNamesMap();
 
 //------------------------------------------------------------------------------
@@ -46,9 +58,8 @@ static QStringList dictionaries()
 {
     QStringList dicts;
 
-    for (auto& fileInfo : dictionaryDir().entryInfoList())
-        if (fileInfo.fileName().endsWith(dictFileExt))
-            dicts << fileInfo.baseName();
+    for (auto& fileName : dictionaryDir().entryList({'*' + dictFileExt}, QDir::Files))
+        dicts << QFileInfo(fileName).baseName();
 
     return dicts;
 }
@@ -86,92 +97,635 @@ static QString dictionaryEncoding(const QString& affixFilePath)
     return encoding;
 }
 
-Spellchecker* Spellchecker::get(const QString& lang)
+// Dictionaries are converted to UTF-8 when loading, so words are just encoded into a buffer
+// reused by the calling thread, without allocations per word. The codec is only given
+// for dictionaries in other encodings that could not be converted.
+static const std::string& encodeWord(const QString& word, QTextCodec* codec)
 {
-    if (lang.isEmpty()) return nullptr;
+    thread_local std::string buf;
+    buf.clear();
 
-    static QMap<QString, Spellchecker*> checkers;
+    if (codec)
+    {
+        auto bytes = codec->fromUnicode(word);
+        buf.append(bytes.constData(), bytes.size());
+        return buf;
+    }
 
-    if (!checkers.contains(lang))
+    const QChar* chars = word.constData();
+    const int size = word.size();
+    for (int i = 0; i < size; i++)
     {
-        QDir dictDir = dictionaryDir();
+        char32_t c = chars[i].unicode();
+        if (QChar::isHighSurrogate(c) && i + 1 < size && chars[i + 1].isLowSurrogate())
+            c = QChar::surrogateToUcs4(char16_t(c), chars[++i].unicode());
 
-        QFileInfo dictFile(dictDir, lang + dictFileExt);
-        if (!dictFile.exists())
+        if (c < 0x80)
+            buf += char(c);
+        else if (c < 0x800)
         {
-            qWarning() << "Dictionary file does not exist" << dictFile.filePath();
-            return nullptr;
+            buf += char(0xC0 | (c >> 6));
+            buf += char(0x80 | (c & 0x3F));
         }
-
-        QFileInfo affixFile(dictDir, lang + affixFileExt);
-        if (!affixFile.exists())
+        else if (c < 0x10000)
         {
-            qWarning() << "Affix file does not exist" << affixFile.filePath();
-            return nullptr;
+            buf += char(0xE0 | (c >> 12));
+            buf += char(0x80 | ((c >> 6) & 0x3F));
+            buf += char(0x80 | (c & 0x3F));
         }
-
-        auto checker = new Spellchecker(dictFile.absoluteFilePath(),
-                                        affixFile.absoluteFilePath(),
-                                        userDictionaryPath(lang));
-        if (!checker->_hunspell)
+        else
         {
-            delete checker;
-            return nullptr;
+            buf += char(0xF0 | (c >> 18));
+            buf += char(0x80 | ((c >> 12) & 0x3F));
+            buf += char(0x80 | ((c >> 6) & 0x3F));
+            buf += char(0x80 | (c & 0x3F));
         }
+    }
+    return buf;
+}
+
+static QString decodeWord(const std::string& word, QTextCodec* codec)
+{
+    if (codec)
+        return codec->toUnicode(word.data(), int(word.size()));
+    return QString::fromUtf8(word.data(), qsizetype(word.size()));
+}
 
-        checker->_lang = lang;
-        checkers.insert(lang, checker);
+static QStringList readUserDictionary(const QString& userDictionaryPath)
+{
+    QStringList words;
+    if (userDictionaryPath.isEmpty()) return words;
+
+    QFile file(userDictionaryPath);
+    if (!file.exists()) return words;
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        qWarning() << "Unable to open user dictionary file for reading"
+                   << userDictionaryPath << file.errorString();
+        return words;
     }
 
-    return checkers[lang];
+    QTextStream stream(&file);
+#if (QT_VERSION >= QT_VERSION_CHECK(6, 0, 0))
+    stream.setEncoding(QStringConverter::Utf8);
+#else
+    stream.setCodec("UTF-8");
+#endif
+    for (QString word = stream.readLine(); !word.isEmpty(); word = stream.readLine())
+        words << word;
+    file.close();
+    return words;
+}
+
+static void loadUserDictionary(Hunspell* hunspell, QTextCodec* codec, const QString& userDictionaryPath)
+{
+    for (const auto& word : readUserDictionary(userDictionaryPath))
+        hunspell->add(encodeWord(word, codec));
+}
+
+//------------------------------------------------------------------------------
+//                            Converted dictionaries
+//------------------------------------------------------------------------------
+
+// Hunspell can only load dictionaries from text files and builds its tables while parsing them,
+// so there is no precompiled form it could load or map into memory. Only dictionaries in legacy
+// 8-bit encodings gain from caching: they are converted to UTF-8 once, then they are loaded
+// without any encoding conversion for each word. UTF-8 dictionaries are used as they are.
+static QString convertedDictionaryDir()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/dicts";
+}
+
+static bool isUtf8Encoding(const QString& encoding)
+{
+    return encoding.compare("UTF-8", Qt::CaseInsensitive) == 0 ||
+           encoding.compare("UTF8", Qt::CaseInsensitive) == 0;
+}
+
+static QString fileStamp(const QString& filePath)
+{
+    QFileInfo file(filePath);
+    return QString("%1 %2").arg(file.size()).arg(file.lastModified().toMSecsSinceEpoch());
+}
+
+static bool writeUtf8File(const QString& filePath, const QString& text)
+{
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        qWarning() << "Unable to open file for writing" << filePath << file.errorString();
+        return false;
+    }
+    file.write(text.toUtf8());
+    if (!file.commit())
+    {
+        qWarning() << "Unable to write file" << filePath << file.errorString();
+        return false;
+    }
+    return true;
+}
+
+static bool convertFile(const QString& sourcePath, QTextCodec* codec, QString& text)
+{
+    QFile file(sourcePath);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        qWarning() << "Unable to open file for reading" << sourcePath << file.errorString();
+        return false;
+    }
+    text = codec->toUnicode(file.readAll());
+    return true;
+}
+
+// Returns false if dictionary can't be converted, then original files should be used.
+// On success, the paths are replaced with paths of the converted files.
+static bool convertDictionary(const QString& convertedDir, QTextCodec* codec, QString& dictFilePath, QString& affixFilePath)
+{
+    // Several threads can load the same dictionary at once
+    static QMutex mutex;
+    QMutexLocker lock(&mutex);
+
+    if (convertedDir.isEmpty() || !QDir().mkpath(convertedDir))
+        return false;
+
+    QString baseName = QFileInfo(dictFilePath).completeBaseName();
+    QString convertedDictPath = convertedDir + '/' + baseName + dictFileExt;
+    QString convertedAffixPath = convertedDir + '/' + baseName + affixFileExt;
+    QString stampPath = convertedDir + '/' + baseName + ".stamp";
+
+    // The stamp is written last, so it only exists when conversion has completed
+    QString stamp = fileStamp(dictFilePath) + '\n' + fileStamp(affixFilePath);
+    QFile stampFile(stampPath);
+    if (stampFile.open(QIODevice::ReadOnly) && QString::fromUtf8(stampFile.readAll()) == stamp &&
+        QFile::exists(convertedDictPath) && QFile::exists(convertedAffixPath))
+    {
+        dictFilePath = convertedDictPath;
+        affixFilePath = convertedAffixPath;
+        return true;
+    }
+    stampFile.close();
+
+    QString affix, dict;
+    if (!convertFile(affixFilePath, codec, affix) || !convertFile(dictFilePath, codec, dict))
+        return false;
+
+    // In 8-bit dictionaries, flags are single bytes and can be non-ASCII,
+    // they have to be declared as UTF-8 chars after conversion
+    QRegularExpression setOption("^\\s*SET\\s+\\S+.*$", QRegularExpression::MultilineOption);
+    QRegularExpression flagOption("^\\s*FLAG\\s", QRegularExpression::MultilineOption);
+    affix.replace(setOption, flagOption.match(affix).hasMatch() ? "SET UTF-8" : "SET UTF-8\nFLAG UTF-8");
+
+    if (!writeUtf8File(convertedAffixPath, affix) ||
+        !writeUtf8File(convertedDictPath, dict) ||
+        !writeUtf8File(stampPath, stamp))
+        return false;
+
+    dictFilePath = convertedDictPath;
+    affixFilePath = convertedAffixPath;
+    return true;
 }
 
+//------------------------------------------------------------------------------
+//                             SpellcheckerLoader
+//------------------------------------------------------------------------------
 
-Spellchecker::Spellchecker(const QString &dictFilePath, const QString& affixFilePath, const QString &userDictionaryPath)
+struct DictionaryData
 {
-    _userDictionaryPath = userDictionaryPath;
+    Hunspell* hunspell = nullptr;
+    QTextCodec* codec = nullptr; // Null for UTF-8 dictionaries
+    QString dictFilePath; // Converted file if the dictionary has been converted
+    QString version; // Stamps of original dictionary files
+    qint64 memory = 0;
+    qint64 loadTimeMs = 0;
+};
+
+// It's run in a worker thread, parsing of large dictionaries can take seconds
+static DictionaryData loadDictionary(QString dictFilePath, QString affixFilePath,
+                                     const QString& userDictionaryPath, const QString& convertedDir)
+{
+    DictionaryData data;
+    QElapsedTimer timer;
+    timer.start();
 
     QString encoding = dictionaryEncoding(affixFilePath);
     if (encoding.isEmpty())
     {
         qWarning() << "Unable to detect dictionary encoding in affix file"
                    << affixFilePath << "Spellcheck is unavailable";
-        return;
+        return data;
     }
 
-    _codec = QTextCodec::codecForName(encoding.toLatin1().constData());
-    if (!_codec)
+    data.codec = QTextCodec::codecForName(encoding.toLatin1().constData());
+    if (!data.codec)
     {
         qWarning() << "Codec not found for encoding" << encoding
                    << "detected in dictionary" << affixFilePath
                    << "Spellcheck is unavailable";
-        return;
+        return data;
+    }
+
+    data.version = fileStamp(dictFilePath) + '\n' + fileStamp(affixFilePath);
+
+    if (isUtf8Encoding(encoding) || convertDictionary(convertedDir, data.codec, dictFilePath, affixFilePath))
+        data.codec = nullptr;
+
+    data.hunspell = new Hunspell(affixFilePath.toLocal8Bit().constData(),
+                                 dictFilePath.toLocal8Bit().constData());
+
+    loadUserDictionary(data.hunspell, data.codec, userDictionaryPath);
+
+    // Hunspell doesn't tell how much memory it uses, but it's roughly proportional
+    // to the size of dictionary files (word entries, hash tables, affix tables)
+    const int hunspellMemoryFactor = 3;
+    data.memory = (QFileInfo(dictFilePath).size() + QFileInfo(affixFilePath).size()) * hunspellMemoryFactor;
+
+    data.dictFilePath = dictFilePath;
+    data.loadTimeMs = timer.elapsed();
+    return data;
+}
+
+//------------------------------------------------------------------------------
+//                              Suggestion index
+//------------------------------------------------------------------------------
+
+// Stems listed in the dictionary file, lines are like `word/FLAGS morphology`
+static QStringList readDictionaryWords(const QString& dictFilePath, QTextCodec* codec)
+{
+    QStringList words;
+
+    QFile file(dictFilePath);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        qWarning() << "Unable to open dictionary file for reading" << dictFilePath << file.errorString();
+        return words;
+    }
+
+    auto data = file.readAll();
+    auto text = codec ? codec->toUnicode(data) : QString::fromUtf8(data);
+    const auto lines = QStringView(text).split('\n', Qt::SkipEmptyParts);
+
+    // The first line is the number of words
+    for (int i = 1; i < lines.size(); i++)
+    {
+        auto line = lines.at(i);
+        int stop = 0;
+        while (stop < line.size())
+        {
+            auto c = line.at(stop);
+            if (c == '/' && (stop == 0 || line.at(stop-1) != '\\')) break;
+            if (c == '\t' || c == ' ' || c == '\r') break;
+            stop++;
+        }
+        if (stop > 0)
+            words << line.first(stop).toString().replace("\\/", "/");
+    }
+    return words;
+}
+
+// It's run in a worker thread
+static SuggestIndex* loadSuggestIndex(const QString& dictFilePath, QTextCodec* codec,
+                                      const QString& userDictionaryPath, const QString& indexFilePath)
+{
+    // The index is rebuilt when the dictionary or the user dictionary changes
+    QString stamp = fileStamp(dictFilePath) + '\n' + fileStamp(userDictionaryPath);
+
+    auto index = SuggestIndex::load(indexFilePath, stamp);
+    if (index) return index;
+
+    auto words = readDictionaryWords(dictFilePath, codec);
+    if (words.isEmpty()) return nullptr;
+
+    index = SuggestIndex::build(words + readUserDictionary(userDictionaryPath));
+    if (QDir().mkpath(QFileInfo(indexFilePath).absolutePath()))
+        index->save(indexFilePath, stamp);
+    return index;
+}
+
+namespace {
+// Dictionaries are kept for a while after their last editor is closed, because
+// the user could switch between memos, and loading of a dictionary takes seconds
+const qint64 idleTimeoutMs = 10 * 60 * 1000;
+// Dictionary is never unloaded right after detaching, some background jobs can still use it
+const qint64 minIdleMs = 5000;
+const int unloadCheckIntervalMs = 30 * 1000;
+}
+
+// Loads dictionaries and manages their lifetime.
+// Checkers are attached by editors and they are unloaded when not attached for some time,
+// or when loaded dictionaries take more memory than allowed in settings.
+// An unloaded dictionary is loaded again by the next request.
+class SpellcheckerLoader
+{
+public:
+    static SpellcheckerLoader& instance()
+    {
+        static SpellcheckerLoader loader;
+        return loader;
+    }
+
+    void attach(Spellchecker* checker)
+    {
+        checker->_attached++;
+    }
+
+    void detach(Spellchecker* checker)
+    {
+        if (--checker->_attached > 0) return;
+        startIdle(checker);
+    }
+
+    // Preloaded dictionaries could never be attached, so they are idle from the start
+    void startIdle(Spellchecker* checker)
+    {
+        checker->_idleTime.start();
+        if (!_unloadTimer)
+        {
+            _unloadTimer = new QTimer(qApp);
+            _unloadTimer->setInterval(unloadCheckIntervalMs);
+            QObject::connect(_unloadTimer, &QTimer::timeout, qApp, [this]{ unloadUnused(); });
+        }
+        _unloadTimer->start();
+    }
+
+    // Words ignored in this session are added again if the dictionary gets reloaded
+    void wordIgnored(const QString& lang, const QString& word)
+    {
+        _ignored[lang] << word;
+    }
+
+    QStringList ignored(const QString& lang) const { return _ignored.value(lang); }
+
+    Spellchecker* checker(const QString& lang) const { return _checkers.value(lang); }
+    bool isFailed(const QString& lang) const { return _failed.contains(lang); }
+
+    // Returns null if dictionary files don't exist
+    QFutureWatcher<DictionaryData>* load(const QString& lang)
+    {
+        if (_loading.contains(lang))
+            return _loading[lang];
+
+        QDir dictDir = dictionaryDir();
+
+        QFileInfo dictFile(dictDir, lang + dictFileExt);
+        if (!dictFile.exists())
+        {
+            qWarning() << "Dictionary file does not exist" << dictFile.filePath();
+            _failed.insert(lang);
+            return nullptr;
+        }
+
+        QFileInfo affixFile(dictDir, lang + affixFileExt);
+        if (!affixFile.exists())
+        {
+            qWarning() << "Affix file does not exist" << affixFile.filePath();
+            _failed.insert(lang);
+            return nullptr;
+        }
+
+        // User dictionary path comes from settings, get it here rather than in the worker
+        auto userDictPath = userDictionaryPath(lang);
+        auto convertedDir = convertedDictionaryDir();
+
+        auto watcher = new QFutureWatcher<DictionaryData>(qApp);
+        QObject::connect(watcher, &QFutureWatcherBase::finished, watcher, [this, lang, userDictPath, watcher]{
+            _loading.remove(lang);
+            auto data = watcher->result();
+            if (data.hunspell)
+            {
+                for (const auto& word : _ignored.value(lang))
+                    data.hunspell->add(encodeWord(word, data.codec));
+
+                auto checker = new Spellchecker(lang, data.hunspell, data.codec, userDictPath);
+                checker->_memory = data.memory;
+                checker->_version = data.version;
+                checker->loadSuggestIndex(data.dictFilePath);
+                _checkers.insert(lang, checker);
+                startIdle(checker);
+                reportMemory(QString("loaded in %1 ms").arg(data.loadTimeMs), checker);
+                unloadUnused();
+            }
+            else
+                _failed.insert(lang);
+            watcher->deleteLater();
+        });
+        watcher->setFuture(QtConcurrent::run(loadDictionary,
+            dictFile.absoluteFilePath(), affixFile.absoluteFilePath(), userDictPath, convertedDir));
+        _loading.insert(lang, watcher);
+        return watcher;
+    }
+
+private:
+    QMap<QString, Spellchecker*> _checkers;
+    QMap<QString, QFutureWatcher<DictionaryData>*> _loading;
+    QSet<QString> _failed;
+    QMap<QString, QStringList> _ignored;
+    QTimer* _unloadTimer = nullptr;
+
+    qint64 totalMemory() const
+    {
+        qint64 total = 0;
+        for (auto checker : _checkers)
+            total += checker->memory();
+        return total;
+    }
+
+    void unloadUnused()
+    {
+        QVector<Spellchecker*> unused;
+        for (auto checker : _checkers)
+            if (checker->_attached == 0 && checker->_idleTime.isValid() &&
+                checker->_idleTime.elapsed() >= minIdleMs && !checker->isBusy())
+                unused << checker;
+
+        // Least recently used are unloaded first when memory budget is exceeded
+        std::sort(unused.begin(), unused.end(), [](Spellchecker* a, Spellchecker* b){
+            return a->_idleTime.elapsed() > b->_idleTime.elapsed();
+        });
+
+        qint64 budget = qint64(AppSettings::instance().spellcheckMemoryBudget) * 1024 * 1024;
+        qint64 total = totalMemory();
+        for (auto checker : unused)
+        {
+            if (checker->_idleTime.elapsed() < idleTimeoutMs && total <= budget)
+                continue;
+            total -= checker->memory();
+            _checkers.remove(checker->lang());
+            reportMemory("unloaded", checker);
+            delete checker;
+        }
+
+        bool hasDetached = false;
+        for (auto checker : _checkers)
+            if (checker->_attached == 0)
+                hasDetached = true;
+        if (_unloadTimer && !hasDetached)
+            _unloadTimer->stop();
     }
 
-    _hunspell = new Hunspell(affixFilePath.toLocal8Bit().constData(),
-                             dictFilePath.toLocal8Bit().constData());
+    void reportMemory(const QString& event, Spellchecker* checker) const
+    {
+        if (!AppSettings::instance().isDevMode) return;
+
+        const double mb = 1024 * 1024;
+        QStringList langs;
+        for (auto c : _checkers)
+            langs << QString("%1 %2 MB").arg(c->lang()).arg(c->memory() / mb, 0, 'f', 1);
+        qDebug().noquote() << QString("Dictionary %1 %2: ~%3 MB, total ~%4 MB [%5]")
+            .arg(checker->lang(), event).arg(checker->memory() / mb, 0, 'f', 1)
+            .arg(totalMemory() / mb, 0, 'f', 1).arg(langs.join(", "));
+    }
+};
 
-    loadUserDictionary();
+//------------------------------------------------------------------------------
+//                                Spellchecker
+//------------------------------------------------------------------------------
+
+Spellchecker* Spellchecker::get(const QString& lang)
+{
+    return SpellcheckerLoader::instance().checker(lang);
+}
+
+void Spellchecker::request(const QString& lang, QObject* context, const std::function<void(Spellchecker*)>& callback)
+{
+    if (lang.isEmpty()) return callback(nullptr);
+
+    auto& loader = SpellcheckerLoader::instance();
+
+    auto checker = loader.checker(lang);
+    if (checker || loader.isFailed(lang)) return callback(checker);
+
+    auto watcher = loader.load(lang);
+    if (!watcher) return callback(nullptr);
+
+    // The loader is connected first, so the checker is already registered when this is called
+    QObject::connect(watcher, &QFutureWatcherBase::finished, context, [lang, callback]{
+        callback(SpellcheckerLoader::instance().checker(lang));
+    });
+}
+
+void Spellchecker::attach()
+{
+    SpellcheckerLoader::instance().attach(this);
+}
+
+void Spellchecker::detach()
+{
+    SpellcheckerLoader::instance().detach(this);
+}
+
+void Spellchecker::preload(const QStringList& langs)
+{
+    auto& loader = SpellcheckerLoader::instance();
+    for (const auto& lang : langs)
+        if (!lang.isEmpty() && !loader.checker(lang) && !loader.isFailed(lang))
+            loader.load(lang);
+}
+
+Spellchecker::Spellchecker(const QString& lang, Hunspell* hunspell, QTextCodec* codec, const QString &userDictionaryPath)
+    : QObject(), _lang(lang), _userDictionaryPath(userDictionaryPath), _hunspell(hunspell), _codec(codec)
+{
 }
 
 Spellchecker::~Spellchecker()
 {
     if (_hunspell) delete _hunspell;
+    if (_suggestIndex) delete _suggestIndex;
+}
+
+// Suggestions are taken from Hunspell until the index is ready
+void Spellchecker::loadSuggestIndex(const QString& dictFilePath)
+{
+    auto indexFilePath = convertedDictionaryDir() + '/' + _lang + ".suggest";
+
+    _isIndexLoading = true;
+    auto watcher = new QFutureWatcher<SuggestIndex*>(this);
+    connect(watcher, &QFutureWatcherBase::finished, this, [this, watcher]{
+        QMutexLocker lock(&_mutex);
+        _suggestIndex = watcher->result();
+        _suggestCache.clear();
+        _isIndexLoading = false;
+        watcher->deleteLater();
+    });
+    watcher->setFuture(QtConcurrent::run(::loadSuggestIndex, dictFilePath, _codec, _userDictionaryPath, indexFilePath));
+}
+
+namespace {
+// Enough for the vocabulary of a huge memo, the cache is just dropped when it's full
+const int maxCheckCacheSize = 100000;
+const int maxSuggestCacheSize = 1000;
+// When the index gives fewer variants, they are merged with Hunspell's ones
+const int minIndexVariants = 5;
+
+// Suggesting blocks the spellchecker, so there is no point in running several at once,
+// and the global pool should not be occupied by long suggestions
+QThreadPool* suggestPool()
+{
+    static QThreadPool* pool = nullptr;
+    if (!pool)
+    {
+        pool = new QThreadPool(qApp);
+        pool->setMaxThreadCount(1);
+    }
+    return pool;
+}
 }
 
 bool Spellchecker::check(const QString &word) const
 {
-    return _hunspell->spell(_codec->fromUnicode(word).toStdString());
+    QMutexLocker lock(&_mutex);
+
+    auto it = _checkCache.constFind(word);
+    if (it != _checkCache.constEnd())
+        return it.value();
+
+    bool ok = _hunspell->spell(encodeWord(word, _codec));
+
+    if (_checkCache.size() >= maxCheckCacheSize)
+        _checkCache.clear();
+    _checkCache.insert(word, ok);
+    return ok;
 }
 
 void Spellchecker::ignore(const QString &word)
 {
-    _hunspell->add(_codec->fromUnicode(word).toStdString());
+    {
+        QMutexLocker lock(&_mutex);
+        _hunspell->add(encodeWord(word, _codec));
+        _checkCache.remove(word);
+        _suggestCache.remove(word);
+    }
+    SpellcheckerLoader::instance().wordIgnored(_lang, word);
     emit wordIgnored(word);
 }
 
+qint64 Spellchecker::memory() const
+{
+    QMutexLocker lock(&_mutex);
+    return _memory + (_suggestIndex ? _suggestIndex->memory() : 0);
+}
+
+QStringList Spellchecker::ignoredWords() const
+{
+    return SpellcheckerLoader::instance().ignored(_lang);
+}
+
+// Background tasks refer to the spellchecker, it can't be deleted until they are done
+bool Spellchecker::isBusy() const
+{
+    if (_isIndexLoading) return true;
+    for (const auto& future : _suggesting)
+        if (!future.isFinished())
+            return true;
+    return false;
+}
+
 void Spellchecker::save(const QString &word)
 {
+    {
+        QMutexLocker lock(&_mutex);
+        _checkCache.remove(word);
+    }
+
     if (_userDictionaryPath.isEmpty()) return;
 
     QFile file(_userDictionaryPath);
@@ -194,34 +748,122 @@ void Spellchecker::save(const QString &word)
 
 QStringList Spellchecker::suggest(const QString &word) const
 {
+    QMutexLocker lock(&_mutex);
+
+    auto it = _suggestCache.constFind(word);
+    if (it != _suggestCache.constEnd())
+        return it.value();
+
+    // The index only knows dictionary stems, its variants are verified because some stems
+    // are not valid words by themselves (e.g. having NEEDAFFIX flag). Hunspell is still asked
+    // when the index finds only a few variants, it's usually an affixed form of a word
+    // which the index can't produce, and its variants go first then
     QStringList variants;
-    for (auto& variant : _hunspell->suggest(_codec->fromUnicode(word).toStdString()))
-        variants << _codec->toUnicode(QByteArray::fromStdString(variant));
+    if (_suggestIndex)
+        for (const auto& variant : _suggestIndex->suggest(word))
+            if (_hunspell->spell(encodeWord(variant, _codec)))
+                variants << variant;
+
+    if (variants.size() < minIndexVariants)
+    {
+        QStringList hunspellVariants;
+        for (auto& variant : _hunspell->suggest(encodeWord(word, _codec)))
+            hunspellVariants << decodeWord(variant, _codec);
+        for (const auto& variant : variants)
+            if (!hunspellVariants.contains(variant))
+                hunspellVariants << variant;
+        variants = hunspellVariants;
+    }
+
+    if (_suggestCache.size() >= maxSuggestCacheSize)
+        _suggestCache.clear();
+    _suggestCache.insert(word, variants);
     return variants;
 }
 
-void Spellchecker::loadUserDictionary()
+bool Spellchecker::suggestCached(const QString &word, QStringList& variants) const
 {
-    if (_userDictionaryPath.isEmpty()) return;
+    QMutexLocker lock(&_mutex);
 
-    QFile file(_userDictionaryPath);
-    if (!file.exists()) return;
-    if (!file.open(QIODevice::ReadOnly))
-    {
-        qWarning() << "Unable to open user dictionary file for reading"
-                   << _userDictionaryPath << file.errorString();
-        return;
-    }
+    auto it = _suggestCache.constFind(word);
+    if (it == _suggestCache.constEnd()) return false;
 
-    QTextStream stream(&file);
-#if (QT_VERSION >= QT_VERSION_CHECK(6, 0, 0))
-    stream.setEncoding(QStringConverter::Utf8);
-#else
-    stream.setCodec("UTF-8");
-#endif
-    for (QString word = stream.readLine(); !word.isEmpty(); word = stream.readLine())
-        _hunspell->add(_codec->fromUnicode(word).toStdString());
-    file.close();
+    variants = it.value();
+    return true;
+}
+
+QFuture<QStringList> Spellchecker::suggestAsync(const QString &word)
+{
+    for (auto it = _suggesting.begin(); it != _suggesting.end(); )
+        if (it.value().isFinished() || it.value().isCanceled())
+            it = _suggesting.erase(it);
+        else it++;
+
+    if (_suggesting.contains(word))
+        return _suggesting[word];
+
+    auto future = QtConcurrent::run(suggestPool(), [this, word](QPromise<QStringList>& promise){
+        if (!promise.isCanceled())
+            promise.addResult(suggest(word));
+    });
+    _suggesting.insert(word, future);
+    return future;
+}
+
+//------------------------------------------------------------------------------
+//                             ThreadSpellchecker
+//------------------------------------------------------------------------------
+
+ThreadSpellchecker::Files ThreadSpellchecker::files(const QString& lang)
+{
+    Files files;
+    QDir dictDir = dictionaryDir();
+    QFileInfo dictFile(dictDir, lang + dictFileExt);
+    QFileInfo affixFile(dictDir, lang + affixFileExt);
+    if (!dictFile.exists() || !affixFile.exists())
+        return files;
+
+    files.dict = dictFile.absoluteFilePath();
+    files.affix = affixFile.absoluteFilePath();
+    files.userDict = userDictionaryPath(lang);
+    files.convertedDir = convertedDictionaryDir();
+    return files;
+}
+
+ThreadSpellchecker* ThreadSpellchecker::get(const Files& files)
+{
+    // Null is stored too, to not try loading a broken dictionary again
+    thread_local QMap<QString, QSharedPointer<ThreadSpellchecker>> checkers;
+
+    auto it = checkers.constFind(files.dict);
+    if (it != checkers.constEnd())
+        return it.value().data();
+
+    QSharedPointer<ThreadSpellchecker> checker;
+    auto data = loadDictionary(files.dict, files.affix, files.userDict, files.convertedDir);
+    if (data.hunspell)
+        checker.reset(new ThreadSpellchecker(data.hunspell, data.codec));
+    checkers.insert(files.dict, checker);
+    return checker.data();
+}
+
+ThreadSpellchecker::~ThreadSpellchecker()
+{
+    delete _hunspell;
+}
+
+bool ThreadSpellchecker::check(const QString& word)
+{
+    auto it = _checkCache.constFind(word);
+    if (it != _checkCache.constEnd())
+        return it.value();
+
+    bool ok = _hunspell->spell(encodeWord(word, _codec));
+
+    if (_checkCache.size() >= maxCheckCacheSize)
+        _checkCache.clear();
+    _checkCache.insert(word, ok);
+    return ok;
 }
 
 //------------------------------------------------------------------------------
@@ -230,13 +872,35 @@ void Spellchecker::loadUserDictionary()
 
 SpellcheckControl::SpellcheckControl(QObject* parent) : QObject(parent)
 {
-    auto dicts = dictionaries();
-    if (dicts.isEmpty()) return;
+}
+
+QMenu* SpellcheckControl::makeMenu(QWidget* parent)
+{
+    // Dictionaries are looked for and actions are made when the menu is shown for the first time,
+    // there is no need to scan the dictionary dir and build language names while the app is starting
+    _menu = new QMenu(tr("Spellcheck"), parent);
+    connect(_menu, &QMenu::aboutToShow, this, &SpellcheckControl::makeActions);
+    return _menu;
+}
+
+void SpellcheckControl::makeActions()
+{
+    if (_actionGroup) return;
 
-    _actionGroup = new QActionGroup(parent);
+    _actionGroup = new QActionGroup(parent());
     _actionGroup->setExclusive(true);
+    _actionGroup->setEnabled(_enabled);
     connect(_actionGroup, &QActionGroup::triggered, this, &SpellcheckControl::actionGroupTriggered);
 
+    auto dicts = dictionaries();
+    if (dicts.isEmpty())
+    {
+        auto actionEmpty = new QAction(tr("No dictionaries found"), this);
+        actionEmpty->setEnabled(false);
+        _menu->addAction(actionEmpty);
+        return;
+    }
+
     auto actionNone = new QAction(tr("None"), this);
     actionNone->setCheckable(true);
     _actionGroup->addAction(actionNone);
@@ -250,20 +914,14 @@ SpellcheckControl::SpellcheckControl(QObject* parent) : QObject(parent)
         actionDict->setData(lang);
         _actionGroup->addAction(actionDict);
     }
-}
-
-QMenu* SpellcheckControl::makeMenu(QWidget* parent)
-{
-    if (!_actionGroup) return nullptr;
 
-    auto menu = new QMenu(tr("Spellcheck"), parent);
-    menu->addActions(_actionGroup->actions());
-    return menu;
+    _menu->addActions(_actionGroup->actions());
 }
 
 void SpellcheckControl::showCurrentLang(const QString& lang)
 {
-    if (!_actionGroup) return;
+    if (!_menu) return;
+    makeActions();
 
     for (auto action : _actionGroup->actions())
         if (action->data().toString() == lang)
@@ -275,6 +933,7 @@ void SpellcheckControl::showCurrentLang(const QString& lang)
 
 void SpellcheckControl::setEnabled(bool on)
 {
+    _enabled = on;
     if (_actionGroup) _actionGroup->setEnabled(on);
 }
 
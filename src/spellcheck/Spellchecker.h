@@ -3,7 +3,14 @@
 
 #ifdef ENABLE_SPELLCHECK
 
+#include <QElapsedTimer>
+#include <QFuture>
+#include <QHash>
+#include <QMutex>
 #include <QObject>
+#include <QStringList>
+
+#include <functional>
 
 QT_BEGIN_NAMESPACE
 class QAction;
@@ -14,34 +21,120 @@ class QTextCodec;
 QT_END_NAMESPACE
 
 class Hunspell;
+class SuggestIndex;
 
 class Spellchecker : public QObject
 {
     Q_OBJECT
 
 public:
+    // Returns the spellchecker if its dictionary is already loaded, otherwise null.
     static Spellchecker* get(const QString& lang);
 
+    // Calls the callback with the spellchecker for the language. If the dictionary is not loaded yet,
+    // it's loaded in a background thread and the callback is called later in the context's thread,
+    // or not called at all if the context gets deleted before. Null is passed if there is no dictionary.
+    static void request(const QString& lang, QObject* context, const std::function<void(Spellchecker*)>& callback);
+
+    // Starts loading of dictionaries that are likely to be required soon.
+    static void preload(const QStringList& langs);
+
     ~Spellchecker();
 
+    // Editors attach to the spellchecker while they use it. Dictionaries which are not attached
+    // are unloaded after a while or when they take too much memory, then get() returns null.
+    void attach();
+    void detach();
+
+    // Approximate memory used by the dictionary and its indexes
+    qint64 memory() const;
+
+    // Changes when dictionary files are changed, results of checking can be reused until then
+    const QString& version() const { return _version; }
+
+    // Words ignored in this session, they are not stored anywhere
+    QStringList ignoredWords() const;
+
+    // Checking and suggesting are thread-safe, they can be called from worker threads
     const QString& lang() const { return _lang; }
     bool check(const QString &word) const;
     void ignore(const QString &word);
     void save(const QString &word);
     QStringList suggest(const QString &word) const;
 
+    // Suggestions are computed in a background thread, one word at a time. Requests for the same word
+    // share the same computation, a request can be canceled by the future until it's started.
+    QFuture<QStringList> suggestAsync(const QString &word);
+    bool suggestCached(const QString &word, QStringList& variants) const;
+
 signals:
     void wordIgnored(const QString& word);
 
 private:
-    Spellchecker(const QString &dictFilePath, const QString &affixFilePath, const QString &userDictionaryPath);
+    Spellchecker(const QString& lang, Hunspell* hunspell, QTextCodec* codec, const QString& userDictionaryPath);
+    void loadSuggestIndex(const QString& dictFilePath);
 
     QString _lang;
     QString _userDictionaryPath;
+    QString _version;
     Hunspell* _hunspell = nullptr;
-    QTextCodec *_codec;
+    QTextCodec *_codec; // Null for UTF-8 dictionaries, they don't need conversion
+    SuggestIndex* _suggestIndex = nullptr;
+    bool _isIndexLoading = false;
+    qint64 _memory = 0;
+    int _attached = 0;
+    QElapsedTimer _idleTime;
+
+    bool isBusy() const;
+
+    // Hunspell is not thread-safe, even its spell() modifies internal buffers
+    mutable QMutex _mutex;
+
+    // Natural text repeats the same words constantly, so results are cached
+    // to avoid encoding conversion and affix analysis for each occurrence
+    mutable QHash<QString, bool> _checkCache;
+
+    // Suggesting is slow, and the same word is usually asked several times
+    // (speculatively, then from the context menu, then after the menu was closed)
+    mutable QHash<QString, QStringList> _suggestCache;
+    QHash<QString, QFuture<QStringList>> _suggesting;
+
+    friend class SpellcheckerLoader;
+};
+
+
+// Checker for batch jobs in worker threads. Shared spellcheckers serialize all calls,
+// so a batch job would block editors and could not load several cores. Instead,
+// each worker thread loads its own dictionary, and it lives until the thread finishes.
+class ThreadSpellchecker
+{
+public:
+    struct Files
+    {
+        QString dict;
+        QString affix;
+        QString userDict;
+        QString convertedDir;
+
+        bool isValid() const { return !dict.isEmpty(); }
+    };
+
+    // Dictionary paths depend on app settings, so they should be resolved in the main thread.
+    static Files files(const QString& lang);
+
+    // Returns the checker owned by the calling thread, or null if the dictionary can't be loaded.
+    static ThreadSpellchecker* get(const Files& files);
+
+    ~ThreadSpellchecker();
+
+    bool check(const QString& word);
+
+private:
+    ThreadSpellchecker(Hunspell* hunspell, QTextCodec* codec): _hunspell(hunspell), _codec(codec) {}
 
-    void loadUserDictionary();
+    Hunspell* _hunspell;
+    QTextCodec* _codec;
+    QHash<QString, bool> _checkCache;
 };
 
 
@@ -61,8 +154,11 @@ signals:
     void langSelected(const QString& lang);
 
 private:
+    QMenu* _menu = nullptr;
     QActionGroup* _actionGroup = nullptr;
+    bool _enabled = true;
 
+    void makeActions();
     void actionGroupTriggered(QAction* action);
 };
 
@@ -0,0 +1,229 @@
+#include "SuggestIndex.h"
+
+#ifdef ENABLE_SPELLCHECK
+
+#include <QDataStream>
+#include <QDebug>
+#include <QFile>
+#include <QSaveFile>
+#include <QSet>
+#include <QVarLengthArray>
+
+#include <algorithm>
+
+namespace {
+
+const quint32 fileMagic = 0x53475358; // SGSX
+const quint32 fileVersion = 1;
+
+// Only word prefixes are indexed, it makes the index several times smaller,
+// long words are still found by their beginning and verified by full distance
+const int prefixLength = 7;
+
+// FNV-1a, it must not change between runs as hashes are stored in the cache file
+quint32 hashOf(const QString& text)
+{
+    quint32 hash = 2166136261u;
+    for (auto c : text)
+    {
+        hash ^= c.unicode();
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+void collectDeletes(const QString& text, int distance, QSet<quint32>& hashes)
+{
+    hashes.insert(hashOf(text));
+    if (distance == 0 || text.size() <= 1) return;
+
+    for (int i = 0; i < text.size(); i++)
+    {
+        QString shorter(text);
+        shorter.remove(i, 1);
+        collectDeletes(shorter, distance - 1, hashes);
+    }
+}
+
+// Optimal string alignment distance (Levenshtein plus transpositions of adjacent chars),
+// the calculation stops as soon as it's clear that distance is greater than maxDistance
+int editDistance(const QString& a, const QString& b, int maxDistance)
+{
+    const int n = a.size();
+    const int m = b.size();
+    if (qAbs(n - m) > maxDistance) return maxDistance + 1;
+
+    QVarLengthArray<int, 64> rows(3 * (m + 1));
+    int* prev2 = rows.data();
+    int* prev = prev2 + m + 1;
+    int* cur = prev + m + 1;
+    for (int j = 0; j <= m; j++) prev[j] = j;
+
+    for (int i = 1; i <= n; i++)
+    {
+        cur[0] = i;
+        int rowMin = i;
+        for (int j = 1; j <= m; j++)
+        {
+            int cost = a.at(i-1) == b.at(j-1) ? 0 : 1;
+            int d = qMin(qMin(prev[j] + 1, cur[j-1] + 1), prev[j-1] + cost);
+            if (i > 1 && j > 1 && a.at(i-1) == b.at(j-2) && a.at(i-2) == b.at(j-1))
+                d = qMin(d, prev2[j-2] + 1);
+            cur[j] = d;
+            rowMin = qMin(rowMin, d);
+        }
+        if (rowMin > maxDistance) return maxDistance + 1;
+
+        int* tmp = prev2;
+        prev2 = prev;
+        prev = cur;
+        cur = tmp;
+    }
+    return prev[m];
+}
+
+QString matchCase(const QString& variant, const QString& word)
+{
+    if (word.size() > 1 && word == word.toUpper())
+        return variant.toUpper();
+    if (word.at(0).isUpper() && variant.at(0).isLower())
+        return variant.at(0).toUpper() + variant.mid(1);
+    return variant;
+}
+
+} // namespace
+
+SuggestIndex* SuggestIndex::load(const QString& filePath, const QString& stamp)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) return nullptr;
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+
+    quint32 magic, version;
+    stream >> magic >> version;
+    if (magic != fileMagic || version != fileVersion) return nullptr;
+
+    QString fileStamp;
+    stream >> fileStamp;
+    if (fileStamp != stamp) return nullptr;
+
+    auto index = new SuggestIndex;
+    stream >> index->_words >> index->_deletes;
+    if (stream.status() != QDataStream::Ok)
+    {
+        qWarning() << "Unable to read suggestion index" << filePath;
+        delete index;
+        return nullptr;
+    }
+    return index;
+}
+
+bool SuggestIndex::save(const QString& filePath, const QString& stamp) const
+{
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        qWarning() << "Unable to open file for writing" << filePath << file.errorString();
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+    stream << fileMagic << fileVersion << stamp << _words << _deletes;
+
+    if (!file.commit())
+    {
+        qWarning() << "Unable to write suggestion index" << filePath << file.errorString();
+        return false;
+    }
+    return true;
+}
+
+SuggestIndex* SuggestIndex::build(const QStringList& words)
+{
+    auto index = new SuggestIndex;
+
+    QSet<QString> seen;
+    QSet<quint32> hashes;
+    for (const auto& word : words)
+    {
+        if (word.isEmpty() || seen.contains(word)) continue;
+        seen.insert(word);
+
+        quint64 wordIndex = index->_words.size();
+        index->_words << word;
+
+        hashes.clear();
+        collectDeletes(word.toLower().left(prefixLength), maxDistance, hashes);
+        for (auto hash : hashes)
+            index->_deletes << (quint64(hash) << 32 | wordIndex);
+    }
+
+    std::sort(index->_deletes.begin(), index->_deletes.end());
+    return index;
+}
+
+QStringList SuggestIndex::suggest(const QString& word, int maxCount) const
+{
+    if (word.isEmpty()) return QStringList();
+
+    auto key = word.toLower();
+
+    QSet<quint32> hashes;
+    collectDeletes(key.left(prefixLength), maxDistance, hashes);
+
+    QSet<int> candidates;
+    for (auto hash : hashes)
+    {
+        auto it = std::lower_bound(_deletes.cbegin(), _deletes.cend(), quint64(hash) << 32);
+        for (; it != _deletes.cend() && quint32(*it >> 32) == hash; it++)
+            candidates.insert(int(*it & 0xFFFFFFFF));
+    }
+
+    struct Match
+    {
+        int distance;
+        bool sameStart;
+        const QString* word;
+    };
+    QVector<Match> matches;
+    for (int i : candidates)
+    {
+        const auto& candidate = _words.at(i);
+        int distance = editDistance(key, candidate.toLower(), maxDistance);
+        if (distance <= maxDistance)
+            matches << Match {distance, candidate.at(0).toLower() == key.at(0), &candidate};
+    }
+
+    // There are no word frequencies in Hunspell dictionaries, so words with the same first letter
+    // go first, people rarely misspell the beginning of a word
+    std::sort(matches.begin(), matches.end(), [](const Match& a, const Match& b){
+        if (a.distance != b.distance) return a.distance < b.distance;
+        if (a.sameStart != b.sameStart) return a.sameStart;
+        return *a.word < *b.word;
+    });
+
+    QStringList variants;
+    for (const auto& match : matches)
+    {
+        auto variant = matchCase(*match.word, word);
+        if (variant == word || variants.contains(variant)) continue;
+        variants << variant;
+        if (variants.size() >= maxCount) break;
+    }
+    return variants;
+}
+
+qint64 SuggestIndex::memory() const
+{
+    // QString data are stored in separate blocks with their own headers
+    const int stringOverhead = 32;
+    qint64 size = _deletes.size() * sizeof(quint64);
+    for (const auto& word : _words)
+        size += word.size() * sizeof(QChar) + stringOverhead;
+    return size;
+}
+
+#endif // ENABLE_SPELLCHECK
@@ -0,0 +1,43 @@
+#ifndef SUGGEST_INDEX_H
+#define SUGGEST_INDEX_H
+
+#ifdef ENABLE_SPELLCHECK
+
+#include <QStringList>
+#include <QVector>
+
+// Symmetric delete index for spelling suggestions (see SymSpell algorithm).
+//
+// For each dictionary word, all variants made by deleting up to maxDistance chars
+// from its prefix are stored. Variants of a misspelled word are made the same way,
+// and words sharing any of them are candidates, which are then verified by edit distance.
+// It only takes a few lookups instead of trying all possible edits as Hunspell does.
+//
+// Dictionary words are only stems, so forms made by affix rules are not suggested.
+class SuggestIndex
+{
+public:
+    static const int maxDistance = 2;
+
+    // Returns null if there is no cache file or it was made for another dictionary.
+    static SuggestIndex* load(const QString& filePath, const QString& stamp);
+    static SuggestIndex* build(const QStringList& words);
+    bool save(const QString& filePath, const QString& stamp) const;
+
+    // Returns words closest to the given one, nearest first.
+    QStringList suggest(const QString& word, int maxCount = 10) const;
+
+    qint64 memory() const;
+
+private:
+    SuggestIndex() {}
+
+    QStringList _words;
+
+    // Pairs of delete variant hash (high part) and word index (low part) sorted by hash
+    QVector<quint64> _deletes;
+};
+
+#endif // ENABLE_SPELLCHECK
+
+#endif // SUGGEST_INDEX_H
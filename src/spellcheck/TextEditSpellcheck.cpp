@@ -2,33 +2,202 @@
 
 #ifdef ENABLE_SPELLCHECK
 
+#include "SpellcheckCache.h"
 #include "Spellchecker.h"
 #include "../TextEditHelpers.h"
+#include "../TextTokenizer.h"
+#include "../highlighter/OriHighlighter.h"
 
 #include <QAction>
 #include <QDebug>
+#include <QFutureWatcher>
 #include <QMenu>
+#include <QScrollBar>
+#include <QTextBlock>
 #include <QTimer>
+#include <QtConcurrent>
+
+#include <algorithm>
 
 using This = TextEditSpellcheck;
 
+//------------------------------------------------------------------------------
+//                              SpellcheckChunk
+//------------------------------------------------------------------------------
+
+// Snapshot of several consecutive blocks, it's checked in a worker thread
+// while the document can be changed in the UI thread.
+struct SpellcheckChunk
+{
+    using Span = SpellcheckCache::Error;
+
+    struct Block
+    {
+        int number;
+        QString text;
+        QVector<Span> skips; // Hyperlinks and no-spell markup (code, commands), sorted, not overlapped
+        QVector<Span> errors;
+    };
+
+    int revision;
+    QVector<Block> blocks;
+};
+
+namespace {
+
+// Roughly a few screens of text checked in background at once, results
+// are applied in batches of this size so the editor stays responsive
+const int chunkMaxChars = 8 * 1024;
+
+void addSkip(QVector<SpellcheckChunk::Span>& skips, int start, int length)
+{
+    if (length <= 0) return;
+
+    // Formats come from different highlighter rules and can go in any order
+    auto it = std::lower_bound(skips.begin(), skips.end(), start,
+        [](const SpellcheckChunk::Span& span, int pos){ return span.start + span.length < pos; });
+    int stop = start + length;
+    auto last = it;
+    while (last != skips.end() && last->start <= stop)
+    {
+        start = qMin(start, last->start);
+        stop = qMax(stop, last->start + last->length);
+        last++;
+    }
+    it = skips.erase(it, last);
+    skips.insert(it, SpellcheckChunk::Span {start, stop - start});
+}
+
+SpellcheckChunk::Block makeBlock(const QTextBlock& block)
+{
+    SpellcheckChunk::Block b;
+    b.number = block.blockNumber();
+    b.text = block.text();
+    for (auto& format : block.layout()->formats())
+        if (format.format.boolProperty(Ori::Highlighter::NoSpellProperty) ||
+            (format.format.isAnchor() && !format.format.anchorHref().isEmpty()))
+            addSkip(b.skips, format.start, format.length);
+    return b;
+}
+
+// Results depend on the text and on what is skipped in it. FNV-1a, it must
+// not change between runs as hashes are stored in the cache file.
+quint64 blockHash(const SpellcheckChunk::Block& block)
+{
+    quint64 hash = 14695981039346656037ull;
+    auto add = [&hash](quint32 value){
+        hash ^= value;
+        hash *= 1099511628211ull;
+    };
+    for (auto c : block.text)
+        add(c.unicode());
+    for (const auto& skip : block.skips)
+    {
+        add(skip.start);
+        add(skip.length);
+    }
+    return hash;
+}
+
+// Takes blocks starting from `first` until `stopPos` or until `maxChars` are collected,
+// `next` receives the first block that is not taken. Skipped spans are taken from highlighting,
+// so taking stops at a block the highlighter has not reached yet (if there is a highlighter).
+SpellcheckChunk makeChunk(const QTextBlock& first, int stopPos, int maxChars,
+                          const Ori::Highlighter::Highlighter* highlighter, QTextBlock& next)
+{
+    SpellcheckChunk chunk;
+    chunk.revision = first.document()->revision();
+
+    int chars = 0;
+    auto block = first;
+    while (block.isValid() && block.position() <= stopPos && chars < maxChars)
+    {
+        if (highlighter && !highlighter->isHighlighted(block))
+            break;
+        chunk.blocks << makeBlock(block);
+        chars += block.length();
+        block = block.next();
+    }
+    next = block;
+    return chunk;
+}
+
+void checkText(Spellchecker* spellchecker, SpellcheckChunk::Block& block, int start, int stop)
+{
+    TextTokenizer words(QStringView(block.text).sliced(start, stop - start));
+    while (words.next())
+    {
+        // Skip one-letter words and abbreviations like e.g.
+        if (words.length() < 2 || words.isAbbreviation())
+            continue;
+
+        if (!spellchecker->check(words.word().toString()))
+            block.errors << SpellcheckChunk::Span {start + words.start(), words.length()};
+    }
+}
+
+// It's run in a worker thread
+SpellcheckChunk checkChunk(Spellchecker* spellchecker, SpellcheckChunk chunk)
+{
+    for (auto& block : chunk.blocks)
+    {
+        // Only text between skipped spans is tokenized,
+        // so a long code line costs nothing regardless of what is inside
+        int pos = 0;
+        for (const auto& skip : block.skips)
+        {
+            if (skip.start > pos)
+                checkText(spellchecker, block, pos, qMin(skip.start, int(block.text.size())));
+            pos = qMax(pos, skip.start + skip.length);
+        }
+        if (pos < block.text.size())
+            checkText(spellchecker, block, pos, block.text.size());
+    }
+    return chunk;
+}
+
+} // namespace
+
+//------------------------------------------------------------------------------
+//                             TextEditSpellcheck
+//------------------------------------------------------------------------------
+
 TextEditSpellcheck::TextEditSpellcheck(QTextEdit *editor, Spellchecker *spellchecker, QObject *parent)
     : QObject(parent), _editor(editor), _spellchecker(spellchecker)
 {
+    _spellchecker->attach();
     connect(_spellchecker, &Spellchecker::wordIgnored, this, &This::wordIgnored);
 
     _editor->setContextMenuPolicy(Qt::CustomContextMenu);
     connect(_editor, &QTextEdit::customContextMenuRequested, this, &This::contextMenuRequested);
     connect(_editor->document(), QOverload<int, int, int>::of(&QTextDocument::contentsChange), this, &This::documentChanged);
-    connect(_editor, &QTextEdit::cursorPositionChanged, this, &This::cursorMoved);
 
     _timer = new QTimer(this);
     _timer->setInterval(500);
     connect(_timer, &QTimer::timeout, this, &This::spellcheckChanges);
+
+    // Off-screen text is checked by small pieces with pauses between them to leave time for
+    // user input, and text which becomes visible on scrolling is moved to the front of the queue
+    _idleTimer = new QTimer(this);
+    _idleTimer->setSingleShot(true);
+    _idleTimer->setInterval(20);
+    connect(_idleTimer, &QTimer::timeout, this, &This::checkIdleChunk);
+    connect(_editor->verticalScrollBar(), &QScrollBar::valueChanged, this, &This::visibleAreaChanged);
+
+    _restTimer = new QTimer(this);
+    _restTimer->setSingleShot(true);
+    _restTimer->setInterval(300);
+    connect(_restTimer, &QTimer::timeout, this, &This::suggestSpeculatively);
+    connect(_editor, &QTextEdit::cursorPositionChanged, _restTimer, QOverload<>::of(&QTimer::start));
 }
 
 TextEditSpellcheck::~TextEditSpellcheck()
 {
+    // The chunk job uses the spellchecker, it can be unloaded as soon as it's detached
+    if (_chunkWatcher)
+        _chunkWatcher->waitForFinished();
+    _spellchecker->detach();
+
     // When program closes we don't know what object is deleted first.
     // This is the only dangerous case we use QPointer for.
     if (_editor)
@@ -37,106 +206,359 @@ TextEditSpellcheck::~TextEditSpellcheck()
 
 void TextEditSpellcheck::spellcheckAll()
 {
-    _spellcheckStart = -1;
-    _spellcheckStop = -1;
-    spellcheck();
-    _editor->setExtraSelections(_errorMarks);
+    clearErrorMarks();
+
+    if (!restoreResults())
+    {
+        QTextCursor range(_editor->document());
+        range.movePosition(QTextCursor::End, QTextCursor::KeepAnchor);
+        _pendingRanges << range;
+    }
+
+    checkNextChunk();
 }
 
-static int selectWord(QTextCursor& cursor)
+// Marks of the previous session are shown right away,
+// and blocks that are not found in the cache are queued for checking
+bool TextEditSpellcheck::restoreResults()
 {
-    // When move cursor to EndOfWord, it stops before bracket, qoute, or punctuation.
-    // But quotes like &raquo; or &rdquo; become a part of the world for some reason.
-    // Remove such punctuation at word boundaries.
+    if (_cacheKey.isEmpty()) return false;
+
+    auto cache = SpellcheckCache::load(_cacheKey, _spellchecker->version());
+    if (cache.isEmpty()) return false;
+
+    // Words ignored in a previous session are misspelled again now
+    for (const auto& word : cache.ignoredWords())
+        if (!_spellchecker->check(word))
+            return false;
 
-    QString word = cursor.selectedText();
-    int length = word.length();
-    int start = 0;
-    int stop = length - 1;
+    auto doc = _editor->document();
+    SpellcheckChunk chunk;
+    chunk.revision = doc->revision();
 
-    while (start < length)
+    auto highlighter = this->highlighter();
+    QTextCursor pending;
+    for (auto block = doc->begin(); block.isValid(); block = block.next())
     {
-        auto ch = word.at(start);
-        if (ch.isLetter() || ch.isDigit()) break;
-        start++;
+        auto b = makeBlock(block);
+        auto errors = (highlighter && !highlighter->isHighlighted(block)) ? nullptr : cache.find(blockHash(b));
+        if (errors)
+        {
+            b.errors = *errors;
+            chunk.blocks << b;
+            if (!pending.isNull())
+            {
+                _pendingRanges << pending;
+                pending = QTextCursor();
+            }
+        }
+        else
+        {
+            if (pending.isNull())
+                pending = QTextCursor(block);
+            pending.setPosition(block.position() + block.length() - 1, QTextCursor::KeepAnchor);
+        }
     }
+    if (!pending.isNull())
+        _pendingRanges << pending;
+
+    QTextCursor range(doc);
+    range.movePosition(QTextCursor::End, QTextCursor::KeepAnchor);
+    applyChunk(chunk, range);
+    return true;
+}
+
+bool TextEditSpellcheck::isChecked(int start, int stop) const
+{
+    auto overlaps = [start, stop](int rangeStart, int rangeStop){
+        return rangeStart <= stop && rangeStop >= start;
+    };
+    for (const auto& range : _pendingRanges)
+        if (overlaps(range.selectionStart(), range.selectionEnd()))
+            return false;
+    if (_isChunkRunning && overlaps(_chunkRange.selectionStart(), _chunkRange.selectionEnd()))
+        return false;
+    if (_changesStart >= 0 && overlaps(_changesStart, _changesStop))
+        return false;
+    return true;
+}
 
-    while (stop > start)
+// Only blocks whose marks are up to date are saved
+void TextEditSpellcheck::saveResults()
+{
+    if (_cacheKey.isEmpty() || !_editor) return;
+
+    SpellcheckCache cache;
+    cache.setIgnoredWords(_spellchecker->ignoredWords());
+
+    auto doc = _editor->document();
+    auto highlighter = this->highlighter();
+    for (auto block = doc->begin(); block.isValid(); block = block.next())
     {
-        auto ch = word.at(stop);
-        if (ch.isLetter() || ch.isDigit()) break;
-        stop--;
+        int start = block.position();
+        int stop = start + block.length() - 1;
+        if (!isChecked(start, stop)) continue;
+        // Without highlighting, the block's hash would be made without its skipped spans
+        if (highlighter && !highlighter->isHighlighted(block)) continue;
+
+        SpellcheckCache::Errors errors;
+        for (int i = findMark(start); i < _marks.size(); i++)
+        {
+            const auto& cursor = _marks.at(i).cursor;
+            if (cursor.selectionStart() > stop) break;
+            errors << SpellcheckCache::Error {cursor.selectionStart() - start, cursor.selectionEnd() - cursor.selectionStart()};
+        }
+        cache.insert(blockHash(makeBlock(block)), errors);
     }
 
-    length = stop - start + 1;
-    int anchor = cursor.anchor();
-    cursor.setPosition(anchor + start, QTextCursor::MoveAnchor);
-    cursor.setPosition(anchor + start + length, QTextCursor::KeepAnchor);
-    return length;
+    cache.save(_cacheKey, _spellchecker->version());
 }
 
-void TextEditSpellcheck::spellcheck()
+// Highlighter of the document if there is any, it marks text which is not spellchecked
+const Ori::Highlighter::Highlighter* TextEditSpellcheck::highlighter() const
 {
-    static auto spellErrorFormat = TextFormat().spellError().get();
+    return _editor->document()->findChild<Ori::Highlighter::Highlighter*>(QString(), Qt::FindDirectChildrenOnly);
+}
+
+void TextEditSpellcheck::visibleRange(int& start, int& stop) const
+{
+    auto viewport = _editor->viewport();
+    start = _editor->cursorForPosition(QPoint(0, 0)).position();
+    stop = _editor->cursorForPosition(QPoint(viewport->width(), viewport->height())).position();
+}
+
+void TextEditSpellcheck::visibleAreaChanged()
+{
+    checkNextChunk();
 
-    _errorMarks.clear();
+    int visibleStart, visibleStop;
+    visibleRange(visibleStart, visibleStop);
+    if (visibleStart < _shownStart || visibleStop > _shownStop)
+        updateVisibleMarks();
+}
 
-    QTextCursor cursor(_editor->document());
+// Text on the screen is checked first, the rest is checked in idle time
+void TextEditSpellcheck::checkNextChunk()
+{
+    if (_isChunkRunning) return;
+    _idleTimer->stop();
 
-    if (_spellcheckStart > -1) cursor.setPosition(_spellcheckStart);
+    auto doc = _editor->document();
+    int visibleStart, visibleStop;
+    visibleRange(visibleStart, visibleStop);
 
-    while ((_spellcheckStop < 0 || cursor.position() < _spellcheckStop) && !cursor.atEnd())
+    while (true)
     {
-        cursor.movePosition(QTextCursor::EndOfWord, QTextCursor::KeepAnchor);
-        int length = selectWord(cursor);
-
-        // When we've skipped punctuation and there is no word,
-        // the cursor may be at the beginning of the next word already.
-        // For example, have text "(word1) word2",
-        // the bracket "(" is treated by QTextEdit as a separate word.
-        // After skipping it, we become at the "w" of "word1" - at the next word after the bracket!
-        // Then moving to `NextWord` shifts the cursor to "word2", and "word1" gets missed.
-        // To avoid, try to find the end of a (possible current) word after skipping punctuation.
-        if (length == 0)
+        int index = -1;
+        for (int i = 0; i < _pendingRanges.size(); i++)
+            if (_pendingRanges.at(i).selectionStart() <= visibleStop &&
+                _pendingRanges.at(i).selectionEnd() >= visibleStart)
+            {
+                index = i;
+                break;
+            }
+        if (index < 0) break;
+
+        // Split the range if it starts above the screen, that part stays pending
+        auto first = doc->findBlock(qMax(_pendingRanges.at(index).selectionStart(), visibleStart));
+        if (first.position() > _pendingRanges.at(index).selectionStart())
         {
-            cursor.movePosition(QTextCursor::EndOfWord, QTextCursor::KeepAnchor);
-            length = selectWord(cursor);
+            auto& range = _pendingRanges[index];
+            int rangeStop = range.selectionEnd();
+            QTextCursor above(range);
+            above.setPosition(range.selectionStart());
+            above.setPosition(first.position() - 1, QTextCursor::KeepAnchor);
+            range.setPosition(first.position());
+            range.setPosition(rangeStop, QTextCursor::KeepAnchor);
+            _pendingRanges.insert(index++, above);
         }
 
-        // Skip one-letter words
-        //
-        // TODO: currently, abbreviations such as "e.i.", "e.g.", "т.д.", "т.п."
-        // are splitted to series of one-letter words and therefore skipped.
-        // It allows mixing of such words in different languages,
-        // e.g. one can use "т.д." in a text in English, it's not ok.
-        //
-        // Similar issue with words like "doesn't" - it splitted into "doesn" and "t",
-        // "t" is skipped and "doesn" gives spelling error. Checking is ok when
-        // true apostrophe character is used (’ = U+2019). But it's not the case
-        // when one type memos via keyboard - single quote is generally used as apostrophe.
-        //
-        // It'd be better to check such words as a whole.
-        //
-        if (length > 1 && TextEditHelpers::hyperlinkAt(cursor).isEmpty())
+        if (startChunk(index, visibleStop)) return;
+    }
+
+    if (!_pendingRanges.isEmpty())
+        _idleTimer->start();
+}
+
+void TextEditSpellcheck::checkIdleChunk()
+{
+    if (_isChunkRunning) return;
+
+    while (!_pendingRanges.isEmpty())
+        if (startChunk(0, INT_MAX)) return;
+}
+
+// Takes blocks from the beginning of the pending range up to stopPos and checks them in background.
+// Returns false if there is nothing to check in the range. Returns true without starting a chunk
+// when the range waits for highlighting, then checking is tried again in idle time.
+bool TextEditSpellcheck::startChunk(int rangeIndex, int stopPos)
+{
+    auto& range = _pendingRanges[rangeIndex];
+    int rangeStop = range.selectionEnd();
+    auto first = _editor->document()->findBlock(range.selectionStart());
+
+    auto highlighter = this->highlighter();
+    if (highlighter && first.isValid() && !highlighter->isHighlighted(first))
+    {
+        _idleTimer->start();
+        return true;
+    }
+
+    QTextBlock next;
+    auto chunk = makeChunk(first, qMin(stopPos, rangeStop), chunkMaxChars, highlighter, next);
+
+    if (next.isValid() && next.position() <= rangeStop)
+    {
+        range.setPosition(next.position());
+        range.setPosition(rangeStop, QTextCursor::KeepAnchor);
+    }
+    else _pendingRanges.removeAt(rangeIndex);
+
+    if (chunk.blocks.isEmpty()) return false;
+
+    _chunkRange = QTextCursor(first);
+    _chunkRange.setPosition(next.isValid() ? next.position() - 1 : rangeStop, QTextCursor::KeepAnchor);
+    _isChunkRunning = true;
+
+    auto watcher = new QFutureWatcher<SpellcheckChunk>(this);
+    connect(watcher, &QFutureWatcherBase::finished, this, [this, watcher]{
+        _isChunkRunning = false;
+        _chunkWatcher = nullptr;
+        applyChunk(watcher->result(), _chunkRange);
+        watcher->deleteLater();
+        checkNextChunk();
+    });
+    watcher->setFuture(QtConcurrent::run(checkChunk, _spellchecker, chunk));
+    _chunkWatcher = watcher;
+    return true;
+}
+
+void TextEditSpellcheck::applyChunk(const SpellcheckChunk& chunk, const QTextCursor& range)
+{
+    auto doc = _editor->document();
+    QVector<ErrorMark> newMarks;
+    auto addMarks = [&](const QTextBlock& block, const QVector<SpellcheckChunk::Span>& errors){
+        for (const auto& error : errors)
         {
-            QString word = cursor.selectedText();
+            QTextCursor cursor(block);
+            cursor.setPosition(block.position() + error.start);
+            cursor.setPosition(block.position() + error.start + error.length, QTextCursor::KeepAnchor);
+
+            // The word could be ignored while the chunk was being checked
+            auto word = cursor.selectedText();
+            if (_spellchecker->check(word)) continue;
+
+            newMarks << ErrorMark {cursor, word};
+        }
+    };
 
-            if (!_spellchecker->check(word))
-                _errorMarks << QTextEdit::ExtraSelection {cursor, spellErrorFormat};
+    if (doc->revision() == chunk.revision)
+    {
+        for (const auto& b : chunk.blocks)
+            addMarks(doc->findBlockByNumber(b.number), b.errors);
+    }
+    else
+    {
+        // The document has been changed while checking, blocks could be shifted or changed.
+        // Results only depend on block text, so they are still valid for unchanged blocks
+        // wherever those blocks are now, and changed blocks are queued for checking again.
+        QHash<QString, const SpellcheckChunk::Block*> results;
+        for (const auto& b : chunk.blocks)
+            results.insert(b.text, &b);
+
+        auto block = doc->findBlock(range.selectionStart());
+        while (block.isValid() && block.position() <= range.selectionEnd())
+        {
+            auto it = results.constFind(block.text());
+            if (it != results.constEnd())
+                addMarks(block, it.value()->errors);
+            else
+            {
+                QTextCursor pending(block);
+                pending.movePosition(QTextCursor::EndOfBlock, QTextCursor::KeepAnchor);
+                _pendingRanges << pending;
+            }
+            block = block.next();
         }
+    }
+
+    // Replace marks in the checked region, new marks are already sorted
+    // because blocks are processed from top to bottom
+    replaceMarks(findMark(range.selectionStart()), findMark(range.selectionEnd() + 1), newMarks);
+
+    updateVisibleMarks();
+}
+
+// Returns index of the first mark starting at or after the position
+int TextEditSpellcheck::findMark(int pos) const
+{
+    auto it = std::lower_bound(_marks.cbegin(), _marks.cend(), pos, [](const ErrorMark& mark, int pos){
+        return mark.cursor.selectionStart() < pos;
+    });
+    return it - _marks.cbegin();
+}
+
+// Replaces marks in [first, last) with the given ones. Old marks are overwritten in place,
+// so the tail of the list is moved only once and only if the number of marks changes.
+void TextEditSpellcheck::replaceMarks(int first, int last, const QVector<ErrorMark>& marks)
+{
+    for (int i = first; i < last; i++)
+        _markWords.remove(_marks.at(i).word, _marks.at(i).cursor);
+
+    int count = last - first;
+    int common = qMin(count, int(marks.size()));
+    for (int i = 0; i < common; i++)
+        _marks[first + i] = marks.at(i);
+    if (count > common)
+        _marks.remove(first + common, count - common);
+    else if (marks.size() > common)
+    {
+        _marks.insert(first + common, marks.size() - common, ErrorMark());
+        for (int i = common; i < marks.size(); i++)
+            _marks[first + i] = marks.at(i);
+    }
+
+    for (const auto& mark : marks)
+        _markWords.insert(mark.word, mark.cursor);
+}
+
+// Marks far from the visible area are not passed to the editor,
+// so it doesn't have to process all of them on each change
+void TextEditSpellcheck::updateVisibleMarks()
+{
+    static auto spellErrorFormat = TextFormat().spellError().get();
+
+    int visibleStart, visibleStop;
+    visibleRange(visibleStart, visibleStop);
 
-        cursor.movePosition(QTextCursor::NextWord, QTextCursor::MoveAnchor);
+    // One more screen above and below, so small edits and scrolls don't reveal not shown marks
+    int margin = visibleStop - visibleStart;
+    _shownStart = visibleStart - margin;
+    _shownStop = visibleStop + margin;
+
+    QList<QTextEdit::ExtraSelection> selections;
+    for (int i = findMark(_shownStart); i < _marks.size(); i++)
+    {
+        const auto& cursor = _marks.at(i).cursor;
+        if (cursor.selectionStart() > _shownStop) break;
+        selections << QTextEdit::ExtraSelection {cursor, spellErrorFormat};
     }
+    _editor->setExtraSelections(selections);
+}
+
+QTextCursor TextEditSpellcheck::markAt(int pos) const
+{
+    // The only mark that can contain the position is the last one starting before it
+    int index = findMark(pos + 1) - 1;
+    if (index >= 0 && pos <= _marks.at(index).cursor.selectionEnd())
+        return _marks.at(index).cursor;
+    return QTextCursor();
 }
 
 QTextCursor TextEditSpellcheck::spellingAt(const QPoint& pos) const
 {
     auto cursor = _editor->cursorForPosition(_editor->viewport()->mapFromParent(pos));
-    auto cursorPos = cursor.position();
-    for (auto es : _editor->extraSelections())
-        if (cursorPos >= es.cursor.anchor() && cursorPos <= es.cursor.position())
-            return es.cursor;
-    return QTextCursor();
+    return markAt(cursor.position());
 }
 
 void TextEditSpellcheck::contextMenuRequested(const QPoint &pos)
@@ -157,24 +579,24 @@ void TextEditSpellcheck::addSpellcheckActions(QMenu* menu, QTextCursor& cursor)
 
     QList<QAction*> actions;
 
-    auto variants = _spellchecker->suggest(word);
-    if (variants.isEmpty())
+    QStringList variants;
+    if (_spellchecker->suggestCached(word, variants))
+        actions << makeVariantActions(menu, cursor, variants);
+    else
     {
-        auto actionNone = new QAction(tr("No variants"), menu);
-        actionNone->setDisabled(true);
-        actions << actionNone;
+        // The menu is shown immediately and suggestions are added when they are ready
+        auto actionSearching = new QAction(tr("Searching..."), menu);
+        actionSearching->setDisabled(true);
+        actions << actionSearching;
+
+        auto watcher = new QFutureWatcher<QStringList>(menu);
+        connect(watcher, &QFutureWatcherBase::finished, menu, [this, menu, cursor, actionSearching, watcher]{
+            auto variants = watcher->future().resultCount() > 0 ? watcher->result() : QStringList();
+            menu->insertActions(actionSearching, makeVariantActions(menu, cursor, variants));
+            menu->removeAction(actionSearching);
+        });
+        watcher->setFuture(_spellchecker->suggestAsync(word));
     }
-    else
-        for (auto variant : variants)
-        {
-            auto actionWord = new QAction(">  " + variant, menu);
-            connect(actionWord, &QAction::triggered, [this, cursor, variant]{
-                _changesLocked = true;
-                const_cast<QTextCursor&>(cursor).insertText(variant);
-                _changesLocked = false;
-            });
-            actions << actionWord;
-        }
 
     auto actionRemember = new QAction(tr("Add to dictionary"), menu);
     connect(actionRemember, &QAction::triggered, [this, cursor, word]{
@@ -196,17 +618,72 @@ void TextEditSpellcheck::addSpellcheckActions(QMenu* menu, QTextCursor& cursor)
     menu->insertActions(menu->actions().first(), actions);
 }
 
+QList<QAction*> TextEditSpellcheck::makeVariantActions(QMenu* menu, const QTextCursor& cursor, const QStringList& variants)
+{
+    QList<QAction*> actions;
+
+    if (variants.isEmpty())
+    {
+        auto actionNone = new QAction(tr("No variants"), menu);
+        actionNone->setDisabled(true);
+        actions << actionNone;
+    }
+    else
+        for (auto variant : variants)
+        {
+            auto actionWord = new QAction(">  " + variant, menu);
+            connect(actionWord, &QAction::triggered, [this, cursor, variant]{
+                removeErrorMark(cursor);
+                _changesLocked = true;
+                const_cast<QTextCursor&>(cursor).insertText(variant);
+                _changesLocked = false;
+            });
+            actions << actionWord;
+        }
+
+    return actions;
+}
+
+// Suggestions for the word under the text cursor are prepared beforehand,
+// so they are likely to be ready when the user opens the context menu
+void TextEditSpellcheck::suggestSpeculatively()
+{
+    auto mark = markAt(_editor->textCursor().position());
+    auto word = mark.isNull() ? QString() : mark.selectedText();
+    if (word == _speculativeWord) return;
+
+    // The future is shared with other callers asking for the same word (e.g. the context menu),
+    // so it's not canceled, only the handle is dropped
+    _speculative = QFuture<QStringList>();
+    _speculativeWord = word;
+
+    QStringList variants;
+    if (word.isEmpty() || _spellchecker->suggestCached(word, variants))
+        return;
+    _speculative = _spellchecker->suggestAsync(word);
+}
+
 void TextEditSpellcheck::removeErrorMark(const QTextCursor& cursor)
 {
-    QList<QTextEdit::ExtraSelection> marks;
-    for (auto mark : _editor->extraSelections())
-        if (mark.cursor != cursor)
-            marks << mark;
-    _editor->setExtraSelections(marks);
+    for (int i = findMark(cursor.selectionStart()); i < _marks.size(); i++)
+    {
+        if (_marks.at(i).cursor.selectionStart() > cursor.selectionStart()) break;
+        if (_marks.at(i).cursor == cursor)
+        {
+            replaceMarks(i, i + 1, QVector<ErrorMark>());
+            updateVisibleMarks();
+            return;
+        }
+    }
 }
 
 void TextEditSpellcheck::clearErrorMarks()
 {
+    _pendingRanges.clear();
+    _marks.clear();
+    _markWords.clear();
+    _shownStart = -1;
+    _shownStop = -1;
     _editor->setExtraSelections(QList<QTextEdit::ExtraSelection>());
 }
 
@@ -221,8 +698,6 @@ void TextEditSpellcheck::documentChanged(int position, int charsRemoved, int cha
     int stopPos = position + charsAdded;
     if (stopPos > _changesStop) _changesStop = stopPos;
 
-    _isHrefChanged = _isHrefChanged || !_hyperlinkAtCursor.isEmpty();
-
     _timer->start();
 }
 
@@ -230,51 +705,49 @@ void TextEditSpellcheck::spellcheckChanges()
 {
     _timer->stop();
 
-    QTextCursor cursor(_editor->document());
-
-    // We could insert spaces and split a word in two.
-    // Then we have to check not only the current word but also the previous one.
-    // That's the reason for shifting to -1 from _changesStart position.
-    // But if there is/was a hyperlink in place of changes,
-    // it can contain arbitrary number of words, then it better to check all the block.
-    cursor.setPosition(_changesStart > 0 ? _changesStart - 1 : _changesStart);
-    cursor.movePosition(_isHrefChanged ? QTextCursor::StartOfBlock : QTextCursor::StartOfWord, QTextCursor::MoveAnchor);
-    _spellcheckStart = cursor.position();
-
-    cursor.setPosition(_changesStop);
-    cursor.movePosition(_isHrefChanged ? QTextCursor::EndOfBlock : QTextCursor::EndOfWord, QTextCursor::KeepAnchor);
-    _spellcheckStop = cursor.position();
-
-    // Remove marks which are in checking range, they will be recreated on spellcheck
-    QList<QTextEdit::ExtraSelection> errorMarks;
-    for (auto es : _editor->extraSelections())
-        if (es.cursor.position() < _spellcheckStart ||
-            es.cursor.anchor() >= _spellcheckStop)
-            errorMarks << es;
+    // Whole blocks are checked again. We could insert spaces and split a word in two,
+    // or change a hyperlink containing arbitrary number of words, it's all covered then.
+    // Changed region is usually small, so it's checked right here in the UI thread.
+    auto doc = _editor->document();
+    auto first = doc->findBlock(qMax(_changesStart, 0));
+    if (first.isValid())
+    {
+        int stopPos = qMin(_changesStop, doc->characterCount() - 1);
+        QTextBlock next;
+        auto chunk = makeChunk(first, stopPos, INT_MAX, highlighter(), next);
 
-    spellcheck();
+        // Blocks which are not highlighted yet are left for idle time
+        if (next.isValid() && next.position() <= stopPos)
+        {
+            QTextCursor pending(next);
+            pending.setPosition(stopPos, QTextCursor::KeepAnchor);
+            _pendingRanges << pending;
+            _idleTimer->start();
+        }
 
-    errorMarks.append(_errorMarks);
-    _editor->setExtraSelections(errorMarks);
+        if (!chunk.blocks.isEmpty())
+        {
+            QTextCursor range(first);
+            range.setPosition(next.isValid() ? next.position() - 1 : doc->characterCount() - 1, QTextCursor::KeepAnchor);
+            applyChunk(checkChunk(_spellchecker, chunk), range);
+        }
+    }
 
-    _spellcheckStart = -1;
-    _spellcheckStop = -1;
     _changesStart = -1;
     _changesStop = -1;
 }
 
-void TextEditSpellcheck::cursorMoved()
-{
-    _hyperlinkAtCursor = TextEditHelpers::hyperlinkAt(_editor->textCursor());
-}
-
 void TextEditSpellcheck::wordIgnored(const QString& word)
 {
-    QList<QTextEdit::ExtraSelection> errorMarks;
-    for (auto es : _editor->extraSelections())
-        if (es.cursor.selectedText() != word)
-            errorMarks << es;
-    _editor->setExtraSelections(errorMarks);
+    if (!_markWords.contains(word)) return;
+
+    // One pass over all marks, removing occurrences one by one would move the tail for each of them
+    auto end = std::remove_if(_marks.begin(), _marks.end(), [&word](const ErrorMark& mark){
+        return mark.word == word;
+    });
+    _marks.erase(end, _marks.end());
+    _markWords.remove(word);
+    updateVisibleMarks();
 }
 
 #endif // ENABLE_SPELLCHECK
@@ -3,13 +3,22 @@
 
 #ifdef ENABLE_SPELLCHECK
 
+#include <QFuture>
+#include <QHash>
 #include <QPointer>
 #include <QTextEdit>
 
 class Spellchecker;
+struct SpellcheckChunk;
+
+namespace Ori {
+namespace Highlighter {
+class Highlighter;
+}}
 
 QT_BEGIN_NAMESPACE
 class QAction;
+class QFutureWatcherBase;
 class QTimer;
 QT_END_NAMESPACE
 
@@ -23,28 +32,68 @@ public:
     void clearErrorMarks();
     void spellcheckAll();
 
+    // Results are saved between sessions under this key, nothing is saved if it's empty
+    void setCacheKey(const QString& key) { _cacheKey = key; }
+    void saveResults();
+
 private:
     QPointer<QTextEdit> _editor;
     Spellchecker* _spellchecker = nullptr;
+    QString _cacheKey;
     QTimer* _timer = nullptr;
+    QTimer* _idleTimer = nullptr;
+    QTimer* _restTimer = nullptr;
     int _changesStart = -1;
     int _changesStop = -1;
-    bool _isHrefChanged = false;
-    int _spellcheckStart = -1;
-    int _spellcheckStop = -1;
-    QList<QTextEdit::ExtraSelection> _errorMarks;
     bool _changesLocked = false;
-    QString _hyperlinkAtCursor;
 
-    void spellcheck();
+    // Document regions which are not checked yet, cursors follow edits
+    QList<QTextCursor> _pendingRanges;
+    // Region of the chunk being checked in background
+    QTextCursor _chunkRange;
+    QFutureWatcherBase* _chunkWatcher = nullptr;
+    bool _isChunkRunning = false;
+
+    struct ErrorMark
+    {
+        QTextCursor cursor;
+        QString word;
+    };
+
+    // Spelling errors sorted by position. Cursors follow edits and never change their order,
+    // so marks can be looked up by binary search. Only marks around the visible area
+    // are passed to the editor as extra selections, their region is [_shownStart, _shownStop].
+    QVector<ErrorMark> _marks;
+    QMultiHash<QString, QTextCursor> _markWords;
+    int _shownStart = -1;
+    int _shownStop = -1;
+
+    // Suggestions started when the text cursor rests on a misspelled word
+    QFuture<QStringList> _speculative;
+    QString _speculativeWord;
+
+    bool restoreResults();
+    bool isChecked(int start, int stop) const;
+    const Ori::Highlighter::Highlighter* highlighter() const;
+    void visibleRange(int& start, int& stop) const;
+    void visibleAreaChanged();
+    void checkNextChunk();
+    void checkIdleChunk();
+    bool startChunk(int rangeIndex, int stopPos);
+    void applyChunk(const SpellcheckChunk& chunk, const QTextCursor& range);
+    QTextCursor markAt(int pos) const;
     QTextCursor spellingAt(const QPoint& pos) const;
     void contextMenuRequested(const QPoint &pos);
     void addSpellcheckActions(QMenu* menu, QTextCursor &cursor);
+    QList<QAction*> makeVariantActions(QMenu* menu, const QTextCursor &cursor, const QStringList& variants);
+    void suggestSpeculatively();
+    int findMark(int pos) const;
+    void replaceMarks(int first, int last, const QVector<ErrorMark>& marks);
     void removeErrorMark(const QTextCursor& cursor);
+    void updateVisibleMarks();
     void documentChanged(int position, int charsRemoved, int charsAdded);
     void spellcheckChanges();
     void wordIgnored(const QString& word);
-    void cursorMoved();
 };
 
 #endif // ENABLE_SPELLCHECK